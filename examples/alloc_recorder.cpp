@@ -0,0 +1,490 @@
+//
+// records an allocation trace of a live process for malloc -t:
+//
+//    BM_ALLOC_TRACE=app.trace LD_PRELOAD=liballoc_recorder.so ./app
+//
+// realloc() is recorded as a free followed by an allocation
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "benchmark/alloctrace.hpp"
+#include "benchmark/benchmark.hpp"
+
+
+namespace
+{
+
+using Trace = Benchmark::AllocTrace;
+
+using MallocFn = void* (*)(std::size_t);
+using FreeFn = void (*)(void*);
+using CallocFn = void* (*)(std::size_t, std::size_t);
+using ReallocFn = void* (*)(void*, std::size_t);
+using PosixMemalignFn = int (*)(void**, std::size_t, std::size_t);
+using AlignedAllocFn = void* (*)(std::size_t, std::size_t);
+
+MallocFn g_malloc = nullptr;
+FreeFn g_free = nullptr;
+CallocFn g_calloc = nullptr;
+ReallocFn g_realloc = nullptr;
+PosixMemalignFn g_posixMemalign = nullptr;
+AlignedAllocFn g_alignedAlloc = nullptr;
+
+// dlsym() may allocate before the real functions are known
+alignas(16) char g_bootstrap[4096];
+std::size_t g_bootstrapUsed = 0;
+bool g_resolving = false;
+
+__thread bool t_inside __attribute__((tls_model("initial-exec"))) = false;
+__thread int t_thread __attribute__((tls_model("initial-exec"))) = -1;
+
+
+void* bootstrapAlloc(std::size_t size) noexcept
+{
+   size = (size + 15) & ~std::size_t(15);
+   if (g_bootstrapUsed + size > sizeof(g_bootstrap))
+      return nullptr;
+
+   auto p = g_bootstrap + g_bootstrapUsed;
+   g_bootstrapUsed += size;
+   return p;
+}
+
+bool isBootstrap(void* p) noexcept
+{
+   auto c = static_cast<char*>(p);
+   return (c >= g_bootstrap) && (c < g_bootstrap + sizeof(g_bootstrap));
+}
+
+void resolve() noexcept
+{
+   if (g_malloc || g_resolving)
+      return;
+
+   g_resolving = true;
+   g_calloc = reinterpret_cast<CallocFn>(::dlsym(RTLD_NEXT, "calloc"));
+   g_free = reinterpret_cast<FreeFn>(::dlsym(RTLD_NEXT, "free"));
+   g_realloc = reinterpret_cast<ReallocFn>(::dlsym(RTLD_NEXT, "realloc"));
+   g_posixMemalign = reinterpret_cast<PosixMemalignFn>(
+      ::dlsym(RTLD_NEXT, "posix_memalign")
+   );
+   g_alignedAlloc = reinterpret_cast<AlignedAllocFn>(
+      ::dlsym(RTLD_NEXT, "aligned_alloc")
+   );
+   g_malloc = reinterpret_cast<MallocFn>(::dlsym(RTLD_NEXT, "malloc"));
+   g_resolving = false;
+}
+
+
+class Recorder final
+{
+public:
+   bool open(char const* path) noexcept
+   {
+      auto tableBytes = sizeof(Entry) * kTableSize;
+      auto slotBytes = sizeof(std::uint32_t) * kTableSize;
+      auto p = ::mmap(
+         nullptr,
+         tableBytes + slotBytes,
+         PROT_READ | PROT_WRITE,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+         -1,
+         0
+      );
+
+      if (p == MAP_FAILED)
+         return false;
+
+      m_table = static_cast<Entry*>(p);
+      m_freeSlots = reinterpret_cast<std::uint32_t*>(
+         static_cast<char*>(p) + tableBytes
+      );
+
+      m_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (m_fd < 0)
+         return false;
+
+      // a valid, empty trace from the start, so a process that never
+      // gets to close() still leaves everything flushed before it died
+      if (!writeHeader() || ::lseek(m_fd, sizeof(Trace::Header), SEEK_SET) < 0)
+         return false;
+
+      m_enabled.store(true, std::memory_order_release);
+      return true;
+   }
+
+   void close() noexcept
+   {
+      if (!m_enabled.exchange(false, std::memory_order_acq_rel))
+         return;
+
+      lock();
+
+      flush();
+
+      ::close(m_fd);
+      m_fd = -1;
+
+      unlock();
+   }
+
+   void allocated(void* p, std::size_t size) noexcept
+   {
+      if (!p || !m_enabled.load(std::memory_order_acquire))
+         return;
+
+      auto thread = threadIndex();
+
+      lock();
+
+      std::uint32_t slot;
+      if (m_freeTop)
+         slot = m_freeSlots[--m_freeTop];
+      else
+         slot = m_nextSlot++;
+
+      auto sz = std::uint32_t(std::min<std::size_t>(size, UINT32_MAX));
+      if (insert(p, slot, sz))
+         append(Trace::Op::Alloc, thread, sz, slot);
+      else
+         m_freeSlots[m_freeTop++] = slot; // table full, drop it
+
+      unlock();
+   }
+
+   // the recorded size of p, or 0 if it was not recorded
+   std::uint32_t freed(void* p) noexcept
+   {
+      if (!p || !m_enabled.load(std::memory_order_acquire))
+         return 0;
+
+      auto thread = threadIndex();
+
+      lock();
+
+      Entry e = {};
+      if (remove(p, e))
+      {
+         m_freeSlots[m_freeTop++] = e.slot;
+         append(Trace::Op::Free, thread, e.size, e.slot);
+      }
+
+      unlock();
+
+      return e.size;
+   }
+
+private:
+   static constexpr unsigned kTableBits = 22;
+   static constexpr std::size_t kTableSize = std::size_t{1} << kTableBits;
+   static constexpr std::size_t kBuffered = 64 * 1024;
+
+   struct Entry
+   {
+      void* p;
+      std::uint32_t slot;
+      std::uint32_t size;
+   };
+
+   void lock() noexcept
+   {
+      while (m_lock.test_and_set(std::memory_order_acquire))
+         ;
+   }
+
+   void unlock() noexcept
+   {
+      m_lock.clear(std::memory_order_release);
+   }
+
+   std::uint16_t threadIndex() noexcept
+   {
+      if (t_thread < 0)
+         t_thread = m_threads.fetch_add(1, std::memory_order_relaxed);
+
+      return std::uint16_t(std::min(t_thread, UINT16_MAX));
+   }
+
+   static std::size_t hash(void* p) noexcept
+   {
+      auto v = reinterpret_cast<std::uintptr_t>(p) >> 4;
+      return (v * 0x9E3779B97F4A7C15ULL) >> (64 - kTableBits);
+   }
+
+   bool insert(void* p, std::uint32_t slot, std::uint32_t size) noexcept
+   {
+      // keep the load factor at 3/4 at most
+      if (m_used >= kTableSize / 4 * 3)
+         return false;
+
+      auto i = hash(p);
+      while (m_table[i].p)
+         i = (i + 1) & (kTableSize - 1);
+
+      m_table[i] = Entry{ p, slot, size };
+      ++m_used;
+      return true;
+   }
+
+   bool remove(void* p, Entry& out) noexcept
+   {
+      auto i = hash(p);
+      while (m_table[i].p != p)
+      {
+         if (!m_table[i].p)
+            return false;
+
+         i = (i + 1) & (kTableSize - 1);
+      }
+
+      out = m_table[i];
+      --m_used;
+
+      // backward shift deletion
+      auto j = i;
+      for (;;)
+      {
+         j = (j + 1) & (kTableSize - 1);
+         if (!m_table[j].p)
+            break;
+
+         auto home = hash(m_table[j].p);
+         if (((j - home) & (kTableSize - 1)) >= ((j - i) & (kTableSize - 1)))
+         {
+            m_table[i] = m_table[j];
+            i = j;
+         }
+      }
+
+      m_table[i] = Entry{};
+      return true;
+   }
+
+   void append(
+      Trace::Op op,
+      std::uint16_t thread,
+      std::uint32_t size,
+      std::uint32_t slot
+   ) noexcept
+   {
+      m_buffer[m_buffered++] = Trace::Record{ op, 0, thread, size, slot };
+      ++m_records;
+
+      if (m_buffered == kBuffered)
+         flush();
+   }
+
+   // the records first, then the header that counts them
+   void flush() noexcept
+   {
+      auto p = reinterpret_cast<char const*>(m_buffer);
+      auto left = m_buffered * sizeof(Trace::Record);
+      while (left)
+      {
+         auto r = ::write(m_fd, p, left);
+         if (r <= 0)
+            break;
+
+         p += r;
+         left -= r;
+      }
+
+      m_buffered = 0;
+
+      // after a short write the file ends mid-record; the header keeps
+      // counting only what came before it
+      if (left)
+         m_truncated = true;
+
+      if (!m_truncated)
+         m_written = m_records;
+
+      writeHeader();
+   }
+
+   bool writeHeader() noexcept
+   {
+      Trace::Header h = {};
+      std::memcpy(h.magic, Trace::Header::kMagic, sizeof(h.magic));
+      h.threads = m_threads.load(std::memory_order_relaxed);
+      h.slots = m_nextSlot;
+      h.records = m_written;
+      return ::pwrite(m_fd, &h, sizeof(h), 0) == sizeof(h);
+   }
+
+   std::atomic<bool> m_enabled = false;
+   std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+   std::atomic<int> m_threads = 0;
+   int m_fd = -1;
+
+   Entry* m_table = nullptr;
+   std::size_t m_used = 0;
+   std::uint32_t* m_freeSlots = nullptr;
+   std::size_t m_freeTop = 0;
+   std::uint32_t m_nextSlot = 0;
+
+   std::uint64_t m_records = 0;
+   std::uint64_t m_written = 0;   // of m_records, on disk
+   bool m_truncated = false;
+   std::size_t m_buffered = 0;
+   Trace::Record m_buffer[kBuffered] = {};
+};
+
+
+constinit Recorder g_recorder;
+
+
+__attribute__((constructor))
+void startRecording()
+{
+   resolve();
+
+   auto path = std::getenv("BM_ALLOC_TRACE");
+   g_recorder.open(path ? path : "alloc.trace");
+}
+
+__attribute__((destructor))
+void stopRecording()
+{
+   g_recorder.close();
+}
+
+
+// a guard against recording our own and libc's nested allocations
+class Scope final
+{
+public:
+   Scope() noexcept
+      : m_outer(!t_inside)
+   {
+      t_inside = true;
+   }
+
+   ~Scope()
+   {
+      if (m_outer)
+         t_inside = false;
+   }
+
+   bool outer() const noexcept
+   {
+      return m_outer;
+   }
+
+private:
+   bool const m_outer;
+};
+
+
+} // namespace
+
+
+extern "C"
+{
+
+BM_EXPORT void* malloc(std::size_t size)
+{
+   resolve();
+   if (!g_malloc)
+      return bootstrapAlloc(size);
+
+   Scope s;
+   auto p = g_malloc(size);
+   if (s.outer())
+      g_recorder.allocated(p, size);
+
+   return p;
+}
+
+BM_EXPORT void* calloc(std::size_t n, std::size_t size)
+{
+   resolve();
+   if (!g_calloc)
+      return bootstrapAlloc(n * size); // static, hence zeroed
+
+   Scope s;
+   auto p = g_calloc(n, size);
+   if (s.outer())
+      g_recorder.allocated(p, n * size);
+
+   return p;
+}
+
+BM_EXPORT void free(void* p)
+{
+   if (!p || isBootstrap(p))
+      return;
+
+   resolve();
+
+   Scope s;
+   if (s.outer())
+      g_recorder.freed(p);
+
+   g_free(p);
+}
+
+BM_EXPORT void* realloc(void* p, std::size_t size)
+{
+   resolve();
+   if (isBootstrap(p))
+   {
+      auto q = malloc(size);
+      if (q)
+      {
+         auto avail = g_bootstrap + sizeof(g_bootstrap) - static_cast<char*>(p);
+         std::memcpy(q, p, std::min<std::size_t>(size, avail));
+      }
+
+      return q;
+   }
+
+   // the free is recorded while p is still ours: once g_realloc()
+   // releases it, another thread may get p and record it first
+   Scope s;
+   std::uint32_t old = s.outer() ? g_recorder.freed(p) : 0;
+   auto q = g_realloc(p, size);
+   if (s.outer())
+   {
+      if (q)
+         g_recorder.allocated(q, size);
+      else if (size && old)
+         g_recorder.allocated(p, old); // failed, p is still live
+   }
+
+   return q;
+}
+
+BM_EXPORT int posix_memalign(void** out, std::size_t align, std::size_t size)
+{
+   resolve();
+
+   Scope s;
+   auto r = g_posixMemalign(out, align, size);
+   if (s.outer() && !r)
+      g_recorder.allocated(*out, size);
+
+   return r;
+}
+
+BM_EXPORT void* aligned_alloc(std::size_t align, std::size_t size)
+{
+   resolve();
+
+   Scope s;
+   auto p = g_alignedAlloc(align, size);
+   if (s.outer())
+      g_recorder.allocated(p, size);
+
+   return p;
+}
+
+} // extern "C"
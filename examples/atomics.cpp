@@ -0,0 +1,452 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+
+namespace
+{
+
+
+// counts the successful operations (and failed CAS attempts) of all the threads
+class Fixture
+   : public Benchmark::Fixture
+{
+public:
+   Fixture(bool cas = false) noexcept
+      : m_cas(cas)
+   {}
+
+   void initialize(unsigned) override
+   {
+      m_ops = 0;
+      m_failures = 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      auto ops = m_ops.load(std::memory_order_relaxed);
+      auto failures = m_failures.load(std::memory_order_relaxed);
+
+      m.push_back({ "ops/s", double(ops), Benchmark::Metric::Kind::Rate });
+
+      if (m_cas)
+      {
+         auto attempts = ops + failures;
+         m.push_back({
+            "% CAS failed",
+            attempts ? 100.0 * double(failures) / double(attempts) : 0.0
+         });
+      }
+   }
+
+protected:
+   static constexpr std::size_t kCacheLine = 64;
+
+   void done(std::uint64_t ops, std::uint64_t failures = 0) noexcept
+   {
+      m_ops.fetch_add(ops, std::memory_order_relaxed);
+      m_failures.fetch_add(failures, std::memory_order_relaxed);
+   }
+
+   static volatile std::uint64_t g_dontOptimize;
+
+private:
+   bool const m_cas;
+   alignas(kCacheLine) std::atomic<std::uint64_t> m_ops = 0;
+   std::atomic<std::uint64_t> m_failures = 0;
+};
+
+volatile std::uint64_t Fixture::g_dontOptimize = 0;
+
+
+class FetchAdd
+   : public Fixture
+{
+public:
+   FetchAdd() noexcept = default;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto const n = iterations;
+      while (iterations--)
+         m_value.fetch_add(1, std::memory_order_relaxed);
+
+      done(n);
+      return 0;
+   }
+
+private:
+   alignas(kCacheLine) std::atomic<std::uint64_t> m_value = 0;
+};
+
+
+class Exchange
+   : public Fixture
+{
+public:
+   Exchange() noexcept = default;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      auto const n = iterations;
+      std::uint64_t sum = 0;
+      while (iterations--)
+         sum += m_value.exchange(tid, std::memory_order_acq_rel);
+
+      g_dontOptimize = sum;
+      done(n);
+      return 0;
+   }
+
+private:
+   alignas(kCacheLine) std::atomic<std::uint64_t> m_value = 0;
+};
+
+
+// an increment as a load + CAS retry loop
+template <bool Weak>
+class CasLoop
+   : public Fixture
+{
+public:
+   CasLoop() noexcept
+      : Fixture(true)
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto const n = iterations;
+      std::uint64_t failures = 0;
+      while (iterations--)
+      {
+         auto v = m_value.load(std::memory_order_relaxed);
+         for (;;)
+         {
+            bool ok;
+            if constexpr (Weak)
+               ok = m_value.compare_exchange_weak(v, v + 1, std::memory_order_acq_rel);
+            else
+               ok = m_value.compare_exchange_strong(v, v + 1, std::memory_order_acq_rel);
+
+            if (ok)
+               break;
+
+            ++failures;
+         }
+      }
+
+      done(n, failures);
+      return 0;
+   }
+
+private:
+   alignas(kCacheLine) std::atomic<std::uint64_t> m_value = 0;
+};
+
+
+// a counter + ABA tag pair, the typical double-width CAS payload
+struct alignas(16) Tagged
+{
+   std::uint64_t value;
+   std::uint64_t tag;
+};
+
+
+// std::atomic<16 bytes>: GCC leaves these to libatomic, which may use a lock
+class Cas128Library
+   : public Fixture
+{
+public:
+   Cas128Library() noexcept
+      : Fixture(true)
+   {}
+
+   static bool lockFree() noexcept
+   {
+      std::atomic<Tagged> a;
+      return a.is_lock_free();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto const n = iterations;
+      std::uint64_t failures = 0;
+      while (iterations--)
+      {
+         auto v = m_value.load(std::memory_order_relaxed);
+         for (;;)
+         {
+            Tagged next = { v.value + 1, v.tag + 1 };
+            if (m_value.compare_exchange_weak(v, next, std::memory_order_acq_rel))
+               break;
+
+            ++failures;
+         }
+      }
+
+      done(n, failures);
+      return 0;
+   }
+
+private:
+   alignas(kCacheLine) std::atomic<Tagged> m_value = Tagged{ 0, 0 };
+};
+
+
+#if defined(__x86_64__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+
+// the __sync builtin is inlined as lock cmpxchg16b under -mcx16
+class Cas128Native
+   : public Fixture
+{
+public:
+   Cas128Native() noexcept
+      : Fixture(true)
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto const n = iterations;
+      std::uint64_t failures = 0;
+      while (iterations--)
+      {
+         // a torn read only costs one more attempt
+         auto v = m_value;
+         for (;;)
+         {
+            auto next = v + ((Word(1) << 64) | 1);
+            auto prev = __sync_val_compare_and_swap(&m_value, v, next);
+            if (prev == v)
+               break;
+
+            v = prev;
+            ++failures;
+         }
+      }
+
+      done(n, failures);
+      return 0;
+   }
+
+private:
+   using Word = unsigned __int128;
+
+   alignas(kCacheLine) Word volatile m_value = 0;
+};
+
+#endif
+
+
+// a store followed by a standalone fence; every thread has its own line
+template <std::memory_order Order>
+class Fence
+   : public Fixture
+{
+public:
+   Fence() noexcept = default;
+
+   void initialize(unsigned threads) override
+   {
+      Fixture::initialize(threads);
+
+      m_lines = std::vector<Line>(threads);
+   }
+
+   void finalize() override
+   {
+      m_lines.clear();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      auto const n = iterations;
+      auto& v = m_lines[tid].value;
+      while (iterations--)
+      {
+         v.store(iterations, std::memory_order_relaxed);
+         std::atomic_thread_fence(Order);
+      }
+
+      done(n);
+      return 0;
+   }
+
+private:
+   struct alignas(kCacheLine) Line
+   {
+      std::atomic<std::uint64_t> value = 0;
+   };
+
+   std::vector<Line> m_lines;
+};
+
+
+//
+// wake latency: threads 2k and 2k + 1 hand a turn back and forth
+// through atomic::wait() / notify_one(); an operation is one handoff
+//
+class WaitNotify
+   : public Fixture
+{
+public:
+   WaitNotify() noexcept = default;
+
+   void initialize(unsigned threads) override
+   {
+      Fixture::initialize(threads);
+
+      m_threads = threads;
+      m_pairs = std::vector<Pair>((threads + 1) / 2);
+   }
+
+   void finalize() override
+   {
+      m_pairs.clear();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      // an unpaired thread has no one to wake
+      if ((tid ^ 1) >= m_threads)
+         return 0;
+
+      auto& turn = m_pairs[tid / 2].turn;
+      std::uint32_t const odd = tid & 1;
+
+      for (std::uint32_t i = 0; i < iterations; ++i)
+      {
+         auto const mine = 2 * i + odd;
+
+         auto v = turn.load(std::memory_order_acquire);
+         while (v != mine)
+         {
+            turn.wait(v, std::memory_order_acquire);
+            v = turn.load(std::memory_order_acquire);
+         }
+
+         turn.store(mine + 1, std::memory_order_release);
+         turn.notify_one();
+      }
+
+      done(iterations);
+      return 0;
+   }
+
+private:
+   struct alignas(kCacheLine) Pair
+   {
+      std::atomic<std::uint32_t> turn = 0;
+   };
+
+   unsigned m_threads = 0;
+   std::vector<Pair> m_pairs;
+};
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t iterations = 10000000ULL;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   Benchmark::Runner r(
+      "Atomic primitives",
+      iterations
+   );
+
+   r.add(
+      "fetch_add() (relaxed)",
+      Benchmark::Fixture::make<FetchAdd>(),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "exchange() (acq_rel)",
+      Benchmark::Fixture::make<Exchange>(),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "compare_exchange_weak() loop",
+      Benchmark::Fixture::make<CasLoop<true>>(),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "compare_exchange_strong() loop",
+      Benchmark::Fixture::make<CasLoop<false>>(),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      std::string("std::atomic<16 bytes> CAS loop, ") +
+         (Cas128Library::lockFree() ? "lock-free" : "not lock-free"),
+      Benchmark::Fixture::make<Cas128Library>(),
+      { 1, 2, 4, 8 }
+   );
+
+#if defined(__x86_64__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+   r.add(
+      "cmpxchg16b CAS loop",
+      Benchmark::Fixture::make<Cas128Native>(),
+      { 1, 2, 4, 8 }
+   );
+#endif
+
+   r.add(
+      "store + atomic_thread_fence(acq_rel)",
+      Benchmark::Fixture::make<Fence<std::memory_order_acq_rel>>(),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "store + atomic_thread_fence(seq_cst)",
+      Benchmark::Fixture::make<Fence<std::memory_order_seq_cst>>(),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "wait() / notify_one() handoff",
+      Benchmark::Fixture::make<WaitNotify>(),
+      { 2, 4, 8 }
+   );
+
+   r.run();
+
+   return 0;
+}
@@ -0,0 +1,452 @@
+//
+// core-to-core latency: for every pair of CPUs this process may run on,
+// two pinned threads bounce a cache line back and forth
+//
+//    c2c [-n <round trips>] [-c <matrix.csv>]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/cmdline.hpp"
+#include "benchmark/stopwatch.hpp"
+#include "benchmark/terminal.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+#if BM_POSIX
+   #include <pthread.h>
+   #include <sched.h>
+#endif
+
+
+namespace
+{
+
+
+// one-way latencies in ns, NaN on the diagonal
+class Matrix final
+{
+public:
+   Matrix(std::size_t n)
+      : m_n(n)
+      , m_values(n * n, std::numeric_limits<double>::quiet_NaN())
+   {}
+
+   std::size_t size() const noexcept
+   {
+      return m_n;
+   }
+
+   double& at(std::size_t i, std::size_t j) noexcept
+   {
+      return m_values[i * m_n + j];
+   }
+
+   double at(std::size_t i, std::size_t j) const noexcept
+   {
+      return m_values[i * m_n + j];
+   }
+
+private:
+   std::size_t m_n;
+   std::vector<double> m_values;
+};
+
+
+#if BM_POSIX
+
+std::vector<int> allowedCpus()
+{
+   std::vector<int> cpus;
+
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   if (::sched_getaffinity(0, sizeof(set), &set) != 0)
+      return cpus;
+
+   for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+   {
+      if (CPU_ISSET(cpu, &set))
+         cpus.push_back(cpu);
+   }
+
+   return cpus;
+}
+
+bool pin(int cpu) noexcept
+{
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+
+// -1 if unknown
+int readInt(std::string const& path)
+{
+   std::ifstream f(path);
+   int v = -1;
+   f >> v;
+   return v;
+}
+
+// "0-3,8,10-11"
+std::vector<int> readCpuList(std::string const& path)
+{
+   std::vector<int> cpus;
+
+   std::ifstream f(path);
+   std::string list;
+   std::getline(f, list);
+
+   std::size_t pos = 0;
+   while (pos < list.size())
+   {
+      auto end = list.find(',', pos);
+      if (end == std::string::npos)
+         end = list.size();
+
+      auto range = list.substr(pos, end - pos);
+      auto dash = range.find('-');
+      auto first = std::atoi(range.c_str());
+      auto last = (dash == std::string::npos) ?
+         first :
+         std::atoi(range.c_str() + dash + 1);
+
+      for (auto cpu = first; cpu <= last; ++cpu)
+         cpus.push_back(cpu);
+
+      pos = end + 1;
+   }
+
+   return cpus;
+}
+
+
+struct Topology
+{
+   int package = -1;
+   int core = -1;
+   std::vector<int> l3;   // CPUs sharing the L3 with this one
+};
+
+Topology topology(int cpu)
+{
+   auto base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+
+   Topology t;
+   t.package = readInt(base + "/topology/physical_package_id");
+   t.core = readInt(base + "/topology/core_id");
+
+   // the last level is normally index3; fall back to whatever is there
+   for (int index = 3; index >= 2 && t.l3.empty(); --index)
+   {
+      auto cache = base + "/cache/index" + std::to_string(index);
+      if (readInt(cache + "/level") == 3)
+         t.l3 = readCpuList(cache + "/shared_cpu_list");
+   }
+
+   return t;
+}
+
+
+enum class Tier
+{
+   SmtSibling,
+   SameL3,
+   SameSocket,
+   CrossSocket,
+   Count
+};
+
+char const* tierName(Tier t) noexcept
+{
+   switch (t)
+   {
+   case Tier::SmtSibling: return "SMT siblings";
+   case Tier::SameL3: return "same L3";
+   case Tier::SameSocket: return "same socket";
+   default: return "cross-socket";
+   }
+}
+
+Tier tier(Topology const& a, Topology const& b, int cpuB) noexcept
+{
+   if (a.package != b.package)
+      return Tier::CrossSocket;
+
+   if (a.core == b.core && a.core >= 0)
+      return Tier::SmtSibling;
+
+   if (std::find(a.l3.begin(), a.l3.end(), cpuB) != a.l3.end())
+      return Tier::SameL3;
+
+   return Tier::SameSocket;
+}
+
+
+// the best one-way latency, in ns, over a few samples of roundTrips each
+double pingPong(int cpuA, int cpuB, std::uint64_t roundTrips)
+{
+   constexpr int kSamples = 3;
+
+   struct alignas(64) Line
+   {
+      std::atomic<std::uint64_t> value = 0;
+   };
+
+   Line line;
+   std::atomic<int> ready = 0;
+   // one flag per thread, combined after the join
+   bool pongPinned = true;
+
+   std::thread pong(
+      [&]()
+      {
+         pongPinned = pin(cpuB);
+
+         ready.fetch_add(1, std::memory_order_acq_rel);
+
+         std::uint64_t expected = 1;
+         for (int s = 0; s < kSamples; ++s)
+         {
+            for (std::uint64_t i = 0; i < roundTrips; ++i)
+            {
+               while (line.value.load(std::memory_order_acquire) != expected)
+                  ;
+
+               line.value.store(expected + 1, std::memory_order_release);
+               expected += 2;
+            }
+         }
+      }
+   );
+
+   bool const pingPinned = pin(cpuA);
+
+   while (ready.load(std::memory_order_acquire) == 0)
+      ;
+
+   double best = std::numeric_limits<double>::max();
+   std::uint64_t next = 1;
+   for (int s = 0; s < kSamples; ++s)
+   {
+      Benchmark::Stopwatch<Benchmark::TimestampProvider> sw;
+      sw.start();
+
+      for (std::uint64_t i = 0; i < roundTrips; ++i)
+      {
+         line.value.store(next, std::memory_order_release);
+         while (line.value.load(std::memory_order_acquire) != next + 1)
+            ;
+
+         next += 2;
+      }
+
+      auto elapsed = sw.stop();
+      best = std::min(best, double(elapsed.count()) / double(2 * roundTrips));
+   }
+
+   pong.join();
+
+   // unpin the main thread again
+   cpu_set_t all;
+   CPU_ZERO(&all);
+   for (auto cpu: allowedCpus())
+      CPU_SET(cpu, &all);
+
+   ::pthread_setaffinity_np(::pthread_self(), sizeof(all), &all);
+
+   return (pingPinned && pongPinned) ? best : std::numeric_limits<double>::quiet_NaN();
+}
+
+#endif // BM_POSIX
+
+
+void printMatrix(
+   Benchmark::Terminal& t,
+   std::vector<int> const& cpus,
+   Matrix const& m
+)
+{
+   constexpr int kWidth = 6;
+   auto& out = t.out();
+
+   t.line(out, '=');
+   out << "Core-to-core one-way latency, ns" << std::endl;
+   t.line(out, '-');
+
+   out << std::setw(kWidth) << "CPU";
+   for (auto cpu: cpus)
+      out << ' ' << std::setw(kWidth) << cpu;
+   out << std::endl;
+
+   for (std::size_t i = 0; i < cpus.size(); ++i)
+   {
+      out << std::setw(kWidth) << cpus[i];
+      for (std::size_t j = 0; j < cpus.size(); ++j)
+      {
+         auto v = m.at(i, j);
+         out << ' ' << std::setw(kWidth);
+         if (v != v)
+            out << "-";
+         else
+            out << std::uint64_t(v + 0.5);
+      }
+
+      out << std::endl;
+   }
+
+   t.line(out, '-');
+}
+
+bool writeCsv(
+   std::string const& path,
+   std::vector<int> const& cpus,
+   Matrix const& m
+)
+{
+   std::ofstream f(path);
+   if (!f)
+      return false;
+
+   f << "cpu";
+   for (auto cpu: cpus)
+      f << "," << cpu;
+   f << "\n";
+
+   for (std::size_t i = 0; i < cpus.size(); ++i)
+   {
+      f << cpus[i];
+      for (std::size_t j = 0; j < cpus.size(); ++j)
+      {
+         f << ",";
+         auto v = m.at(i, j);
+         if (v == v)
+            f << std::fixed << std::setprecision(1) << v;
+      }
+
+      f << "\n";
+   }
+
+   return bool(f);
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t roundTrips = 100000ULL;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      roundTrips,
+      "-n must be a positive integer"
+   );
+
+   Benchmark::Terminal t;
+
+#if BM_POSIX
+   auto cpus = allowedCpus();
+   if (cpus.size() < 2)
+   {
+      t.out() << "Core-to-core latency needs at least 2 CPUs, "
+              << cpus.size() << " available" << std::endl;
+      return 0;
+   }
+
+   std::vector<Topology> topo;
+   for (auto cpu: cpus)
+      topo.push_back(topology(cpu));
+
+   Matrix m(cpus.size());
+   for (std::size_t i = 0; i < cpus.size(); ++i)
+   {
+      for (std::size_t j = i + 1; j < cpus.size(); ++j)
+      {
+         t.out() << "CPU " << cpus[i] << " <-> CPU " << cpus[j] << "\r" << std::flush;
+
+         auto v = pingPong(cpus[i], cpus[j], roundTrips);
+         m.at(i, j) = v;
+         m.at(j, i) = v;
+      }
+   }
+
+   t.out() << std::endl;
+   printMatrix(t, cpus, m);
+
+   // min / avg / max per tier
+   constexpr auto kTiers = std::size_t(Tier::Count);
+   struct Summary
+   {
+      double min = std::numeric_limits<double>::max();
+      double max = 0;
+      double sum = 0;
+      std::size_t pairs = 0;
+   };
+
+   Summary summary[kTiers];
+   for (std::size_t i = 0; i < cpus.size(); ++i)
+   {
+      for (std::size_t j = i + 1; j < cpus.size(); ++j)
+      {
+         auto v = m.at(i, j);
+         if (v != v)
+            continue;
+
+         auto& s = summary[std::size_t(tier(topo[i], topo[j], cpus[j]))];
+         s.min = std::min(s.min, v);
+         s.max = std::max(s.max, v);
+         s.sum += v;
+         ++s.pairs;
+      }
+   }
+
+   t.out() << std::setw(14) << "tier" << " | pairs | min, ns | avg, ns | max, ns" << std::endl;
+   t.line(t.out(), '-');
+   for (std::size_t k = 0; k < kTiers; ++k)
+   {
+      auto& s = summary[k];
+      if (!s.pairs)
+         continue;
+
+      t.out() << std::setw(14) << tierName(Tier(k))
+              << " | " << std::setw(5) << s.pairs
+              << " | " << std::setw(7) << std::uint64_t(s.min + 0.5)
+              << " | " << std::setw(7) << std::uint64_t(s.sum / s.pairs + 0.5)
+              << " | " << std::setw(7) << std::uint64_t(s.max + 0.5)
+              << std::endl;
+   }
+
+   t.line(t.out(), '-');
+
+   std::string_view csv;
+   if (cmd.get("-c", csv) == Benchmark::CmdLine::ArgType::Ok)
+   {
+      if (!writeCsv(std::string(csv), cpus, m))
+      {
+         t.err() << "failed to write " << csv << std::endl;
+         return EXIT_FAILURE;
+      }
+   }
+#else
+   t.out() << "Core-to-core latency needs CPU affinity support" << std::endl;
+#endif
+
+   return 0;
+}
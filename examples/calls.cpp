@@ -1,5 +1,16 @@
+#include <algorithm>
+#include <cstdlib>
 #include <functional>
+#include <iostream>
 #include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
 
 
@@ -13,6 +24,82 @@ namespace
 {
 
 
+// a non-owning reference to a callable
+template <typename Signature>
+class FunctionRef;
+
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> final
+{
+public:
+   FunctionRef() noexcept = default;
+
+   template <typename F>
+      requires (!std::is_same_v<std::remove_cvref_t<F>, FunctionRef>) &&
+         std::is_invocable_r_v<R, F&, Args...>
+   FunctionRef(F& f) noexcept
+      : m_obj(std::addressof(f))
+      , m_invoke(
+         [](void* o, Args... args) -> R
+         {
+            return (*static_cast<F*>(o))(std::forward<Args>(args)...);
+         }
+      )
+   {}
+
+   R operator()(Args... args) const
+   {
+      return m_invoke(m_obj, std::forward<Args>(args)...);
+   }
+
+private:
+   void* m_obj = nullptr;
+   R (*m_invoke)(void*, Args...) = nullptr;
+};
+
+
+// an owning callable with inline storage only, for small trivially
+// copyable targets such as a lambda capturing a pointer or two
+template <typename Signature, std::size_t Size = 2 * sizeof(void*)>
+class Delegate;
+
+template <typename R, typename... Args, std::size_t Size>
+class Delegate<R(Args...), Size> final
+{
+public:
+   Delegate() noexcept = default;
+
+   template <typename F>
+      requires (sizeof(F) <= Size) &&
+         (alignof(F) <= alignof(void*)) &&
+         std::is_trivially_copyable_v<F> &&
+         std::is_invocable_r_v<R, F&, Args...>
+   Delegate(F f) noexcept
+      : m_invoke(
+         [](void* buf, Args... args) -> R
+         {
+            return (*static_cast<F*>(buf))(std::forward<Args>(args)...);
+         }
+      )
+   {
+      ::new (static_cast<void*>(m_buf)) F(f);
+   }
+
+   R operator()(Args... args) const
+   {
+      return m_invoke(m_buf, std::forward<Args>(args)...);
+   }
+
+private:
+   alignas(void*) mutable unsigned char m_buf[Size] = {};
+   R (*m_invoke)(void*, Args...) = nullptr;
+};
+
+
+// the number of concrete IObj types
+constexpr unsigned kMaxTypes = 8;
+
+
 class Fixture
    : public Benchmark::Fixture
 {
@@ -52,8 +139,9 @@ protected:
 
    struct IObj
    {
-      IObj(Benchmark::Random& r)
-         : v(r())
+      IObj(unsigned k, Benchmark::Random& r)
+         : kind(k)
+         , v(r())
       {}
 
       virtual ~IObj() = default;
@@ -99,24 +187,46 @@ protected:
          };
       }
 
+      using FnRef = FunctionRef<void(Value, Value)>;
+      virtual FnRef functionRef() noexcept = 0;
+
+#if __cpp_lib_move_only_function
+      using MoveOnlyFn = std::move_only_function<void(Value, Value)>;
+      virtual MoveOnlyFn moveOnlyMemberFn() noexcept = 0;
+#endif
+
+      using DelegateFn = Delegate<void(Value, Value)>;
+      virtual DelegateFn delegateMemberFn() noexcept = 0;
+
+      unsigned const kind;
       Value v;
    };
 
-   struct A : public IObj
+   // concrete types; even ones subtract, odd ones add
+   template <unsigned K>
+   struct Impl final : public IObj
    {
-      A(Benchmark::Random& r)
-         : IObj(r)
+      Impl(Benchmark::Random& r)
+         : IObj(K, r)
       {
       }
 
+      static void apply(Value& v, Value a, Value b) noexcept
+      {
+         if constexpr (K % 2 == 0)
+            v -= heavyFun(a, b) + K / 2;
+         else
+            v += heavyFun(b, a) + K / 2;
+      }
+
       BM_NOINLINE void virtualMethod(Value a, Value b) noexcept override
       {
-         v -= heavyFun(a, b);
+         apply(v, a, b);
       }
 
       BM_NOINLINE static void staticMethod2(IObj* o, Value a, Value b) noexcept
       {
-         o->v -= heavyFun(a, b);
+         apply(o->v, a, b);
       }
 
       BM_NOINLINE void classMethod2(
@@ -124,13 +234,13 @@ protected:
          Value b
       ) noexcept
       {
-         v -= heavyFun(a, b);
+         apply(v, a, b);
       }
 
       MemberFn bindMemberFn() noexcept override
       {
          return std::bind(
-            &A::classMethod2,
+            &Impl::classMethod2,
             this,
             std::placeholders::_1,
             std::placeholders::_2
@@ -147,60 +257,102 @@ protected:
 
       Fn makeStaticFn() noexcept override
       {
-         return { &A::staticMethod2 };
+         return { &Impl::staticMethod2 };
       }
 
-   };
-
-   struct B : public IObj
-   {
-      B(Benchmark::Random& r)
-         : IObj(r)
+      void operator()(Value a, Value b) noexcept
       {
+         classMethod2(a, b);
       }
 
-      BM_NOINLINE void virtualMethod(Value a, Value b) noexcept override
+      FnRef functionRef() noexcept override
       {
-         v += heavyFun(b, a);
+         return FnRef(*this);
       }
 
-      BM_NOINLINE static void staticMethod2(IObj* o, Value a, Value b) noexcept
+#if __cpp_lib_move_only_function
+      MoveOnlyFn moveOnlyMemberFn() noexcept override
       {
-         o->v += heavyFun(b, a);
+         return [this](Value a, Value b)
+         {
+            this->classMethod2(a, b);
+         };
       }
+#endif
 
-      Fn makeStaticFn() noexcept override
+      DelegateFn delegateMemberFn() noexcept override
       {
-         return { &B::staticMethod2 };
+         return [this](Value a, Value b)
+         {
+            this->classMethod2(a, b);
+         };
       }
+   };
 
-      BM_NOINLINE void classMethod2(
-         Value a,
-         Value b
-      ) noexcept
+   using A = Impl<0>;
+   using B = Impl<1>;
+
+   // calls f.template operator()<K>() for K == kind
+   template <class F>
+   static void withKind(unsigned kind, F&& f)
+   {
+      [&]<unsigned... K>(std::integer_sequence<unsigned, K...>)
       {
-         v += heavyFun(b, a);
-      }
+         ((kind == K ? (f.template operator()<K>(), true) : false) || ...);
+      }(std::make_integer_sequence<unsigned, kMaxTypes>{});
+   }
 
-      MemberFn bindMemberFn() noexcept override
+   // static polymorphism: no vtable, the type is fixed at the call site
+   template <class Derived>
+   struct CrtpBase
+   {
+      CrtpBase(Benchmark::Random& r)
+         : v(r())
+      {}
+
+      void method(Value a, Value b) noexcept
       {
-         return std::bind(
-            &B::classMethod2,
-            this,
-            std::placeholders::_1,
-            std::placeholders::_2
-         );
+         static_cast<Derived*>(this)->methodImpl(a, b);
       }
 
-      MemberFn lambdaMemberFn() noexcept override
+      Value v;
+   };
+
+   template <unsigned K>
+   struct CrtpImpl : public CrtpBase<CrtpImpl<K>>
+   {
+      using CrtpBase<CrtpImpl<K>>::CrtpBase;
+
+      BM_NOINLINE void methodImpl(Value a, Value b) noexcept
       {
-         return [this](Value a, Value b)
-         {
-            this->classMethod2(a, b);
-         };
+         Impl<K>::apply(this->v, a, b);
       }
    };
 
+   using CrtpA = CrtpImpl<0>;
+   using CrtpB = CrtpImpl<1>;
+
+   using Variant = decltype(
+      []<unsigned... K>(std::integer_sequence<unsigned, K...>)
+      {
+         return std::variant<Impl<K>...>(std::in_place_index<0>, rand());
+      }(std::make_integer_sequence<unsigned, kMaxTypes>{})
+   );
+
+   static Variant makeVariant(unsigned kind)
+   {
+      std::optional<Variant> var;
+      withKind(
+         kind,
+         [&var]<unsigned K>()
+         {
+            var.emplace(std::in_place_index<K>, rand());
+         }
+      );
+
+      return std::move(*var);
+   }
+
    std::unique_ptr<IObj> m_obj;
 };
 
@@ -468,6 +620,650 @@ public:
    }
 };
 
+
+class FinalMethod final
+   : public Fixture
+{
+public:
+   FinalMethod() noexcept = default;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      withKind(
+         m_obj->kind,
+         [this, iterations, tid]<unsigned K>()
+         {
+            loop(static_cast<Impl<K>*>(m_obj.get()), iterations, tid);
+         }
+      );
+
+      g_dontOptimize = m_obj->v;
+      return 0;
+   }
+
+private:
+   // the static type is final, so the virtual call is a direct one
+   template <class T>
+   static void loop(
+      T* o,
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) noexcept
+   {
+      while (iterations--)
+      {
+         o->virtualMethod(iterations, tid);
+      }
+   }
+};
+
+
+class CrtpMethod final
+   : public Fixture
+{
+public:
+   CrtpMethod() noexcept = default;
+
+   void initialize(unsigned tid) override
+   {
+      Fixture::initialize(tid);
+
+      m_isA = (m_obj->kind == 0);
+      m_a.reset(new CrtpA(rand()));
+      m_b.reset(new CrtpB(rand()));
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      if (m_isA)
+         g_dontOptimize = loop(*m_a, iterations, tid);
+      else
+         g_dontOptimize = loop(*m_b, iterations, tid);
+
+      return 0;
+   }
+
+private:
+   template <class T>
+   static Value loop(
+      CrtpBase<T>& o,
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) noexcept
+   {
+      while (iterations--)
+      {
+         o.method(iterations, tid);
+      }
+
+      return o.v;
+   }
+
+   bool m_isA = false;
+   std::unique_ptr<CrtpA> m_a;
+   std::unique_ptr<CrtpB> m_b;
+};
+
+
+class VariantMethod final
+   : public Fixture
+{
+public:
+   VariantMethod() noexcept = default;
+
+   void initialize(unsigned tid) override
+   {
+      Fixture::initialize(tid);
+
+      m_var.reset(new Variant(makeVariant(m_obj->kind)));
+   }
+
+   void finalize() override
+   {
+      m_var.reset();
+
+      Fixture::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      auto& var = *m_var;
+      while (iterations--)
+      {
+         std::visit(
+            [iterations, tid](auto& o) { o.classMethod2(iterations, tid); },
+            var
+         );
+      }
+
+      g_dontOptimize = std::visit([](auto& o) { return o.v; }, var);
+      return 0;
+   }
+
+private:
+   std::unique_ptr<Variant> m_var;
+};
+
+
+// calls through a wrapper built from the object by Factory
+template <class Wrapper, auto Factory>
+class WrappedMethod
+   : public Fixture
+{
+public:
+   WrappedMethod() noexcept = default;
+
+   void initialize(unsigned tid) override
+   {
+      Fixture::initialize(tid);
+
+      m_fn = (m_obj.get()->*Factory)();
+   }
+
+   void finalize() override
+   {
+      m_fn = {};
+
+      Fixture::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      while (iterations--)
+      {
+         m_fn(iterations, tid);
+      }
+
+      g_dontOptimize = m_obj->v;
+      return 0;
+   }
+
+private:
+   Wrapper m_fn;
+};
+
+
+//
+// polymorphic call sites: every call goes to the next object of
+// m_objs; the number of dynamic types and the order they come in
+// decide how well the indirect branch predictor can keep up
+//
+
+enum class Order
+{
+   Sorted,     // all objects of one type, then all of the next one...
+   Periodic,   // 0, 1, 2..., 0, 1, 2...
+   Random
+};
+
+std::string_view orderName(Order o) noexcept
+{
+   switch (o)
+   {
+   case Order::Sorted: return "sorted";
+   case Order::Periodic: return "periodic";
+   default: return "random";
+   }
+}
+
+// long enough for a random type sequence not to fit in the
+// predictor's history
+constexpr std::size_t kPolyObjects = 4096;
+
+struct Layout
+{
+   unsigned types = 2;
+   Order order = Order::Random;
+   std::size_t objects = kPolyObjects;
+};
+
+
+class PolyFixture
+   : public Fixture
+{
+public:
+   PolyFixture(Layout const& layout = {}) noexcept
+      : m_layout(layout)
+   {
+   }
+
+   void initialize(unsigned tid) override
+   {
+      Fixture::initialize(tid);
+
+      using Factory = Benchmark::AnyObject<
+         IObj,
+         Impl<0>, Impl<1>, Impl<2>, Impl<3>,
+         Impl<4>, Impl<5>, Impl<6>, Impl<7>
+      >;
+
+      static_assert(Factory::types == kMaxTypes);
+
+      auto const types = std::clamp(m_layout.types, 1u, kMaxTypes);
+      auto const n = m_layout.objects;
+
+      m_objs.reserve(n);
+      for (std::size_t i = 0; i < n; ++i)
+      {
+         std::size_t kind;
+         switch (m_layout.order)
+         {
+         case Order::Sorted:
+            kind = i * types / n;
+            break;
+         case Order::Periodic:
+            kind = i % types;
+            break;
+         default:
+            kind = rand()(types - 1);
+            break;
+         }
+
+         m_objs.push_back(Factory::makeNth(kind, rand()));
+      }
+   }
+
+   void finalize() override
+   {
+      m_objs.clear();
+
+      Fixture::finalize();
+   }
+
+protected:
+   template <class Objects, class Call>
+   static void cycle(
+      Objects& objs,
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid,
+      Call&& call
+   )
+   {
+      std::size_t i = 0;
+      auto const n = objs.size();
+      while (iterations--)
+      {
+         call(objs[i], iterations, tid);
+
+         if (++i == n)
+            i = 0;
+      }
+   }
+
+   Value sum() const noexcept
+   {
+      Value s = 0;
+      for (auto& o: m_objs)
+         s += o->v;
+      return s;
+   }
+
+   Layout const m_layout;
+   Benchmark::AnyObjectVector<IObj> m_objs;
+};
+
+
+class PolyVirtualMethod final
+   : public PolyFixture
+{
+public:
+   using PolyFixture::PolyFixture;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      cycle(
+         m_objs,
+         iterations,
+         tid,
+         [](auto& o, Value a, Value b) { o->virtualMethod(a, b); }
+      );
+
+      g_dontOptimize = sum();
+      return 0;
+   }
+};
+
+
+// a type switch turns each call into a devirtualized one
+class PolyFinalMethod final
+   : public PolyFixture
+{
+public:
+   using PolyFixture::PolyFixture;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      cycle(
+         m_objs,
+         iterations,
+         tid,
+         [](auto& o, Value a, Value b)
+         {
+            switch (o->kind)
+            {
+            case 0: static_cast<Impl<0>*>(o.get())->virtualMethod(a, b); break;
+            case 1: static_cast<Impl<1>*>(o.get())->virtualMethod(a, b); break;
+            case 2: static_cast<Impl<2>*>(o.get())->virtualMethod(a, b); break;
+            case 3: static_cast<Impl<3>*>(o.get())->virtualMethod(a, b); break;
+            case 4: static_cast<Impl<4>*>(o.get())->virtualMethod(a, b); break;
+            case 5: static_cast<Impl<5>*>(o.get())->virtualMethod(a, b); break;
+            case 6: static_cast<Impl<6>*>(o.get())->virtualMethod(a, b); break;
+            case 7: static_cast<Impl<7>*>(o.get())->virtualMethod(a, b); break;
+            }
+         }
+      );
+
+      g_dontOptimize = sum();
+      return 0;
+   }
+};
+
+
+// CRTP objects can't share a container, so they are kept
+// (and called) in one batch per type
+class PolyCrtpMethod final
+   : public PolyFixture
+{
+public:
+   using PolyFixture::PolyFixture;
+
+   void initialize(unsigned tid) override
+   {
+      PolyFixture::initialize(tid);
+
+      for (auto& o: m_objs)
+      {
+         withKind(
+            o->kind,
+            [this]<unsigned K>()
+            {
+               std::get<K>(m_batches).emplace_back(rand());
+            }
+         );
+      }
+   }
+
+   void finalize() override
+   {
+      std::apply([](auto&... b) { (b.clear(), ...); }, m_batches);
+
+      PolyFixture::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      while (iterations)
+      {
+         std::apply(
+            [&iterations, tid](auto&... b) { (batch(b, iterations, tid), ...); },
+            m_batches
+         );
+      }
+
+      Value s = 0;
+      std::apply(
+         [&s](auto&... b)
+         {
+            ((std::for_each(b.begin(), b.end(), [&s](auto& o) { s += o.v; })), ...);
+         },
+         m_batches
+      );
+
+      g_dontOptimize = s;
+      return 0;
+   }
+
+private:
+   template <class T>
+   static void batch(
+      std::vector<T>& objs,
+      Benchmark::Counter& iterations,
+      Benchmark::Tid tid
+   ) noexcept
+   {
+      for (auto& o: objs)
+      {
+         if (!iterations)
+            break;
+
+         --iterations;
+         o.method(iterations, tid);
+      }
+   }
+
+   using Batches = decltype(
+      []<unsigned... K>(std::integer_sequence<unsigned, K...>)
+      {
+         return std::tuple<std::vector<CrtpImpl<K>>...>{};
+      }(std::make_integer_sequence<unsigned, kMaxTypes>{})
+   );
+
+   Batches m_batches;
+};
+
+
+class PolyVariantMethod final
+   : public PolyFixture
+{
+public:
+   using PolyFixture::PolyFixture;
+
+   void initialize(unsigned tid) override
+   {
+      PolyFixture::initialize(tid);
+
+      m_vars.reserve(m_objs.size());
+      for (auto& o: m_objs)
+         m_vars.push_back(makeVariant(o->kind));
+   }
+
+   void finalize() override
+   {
+      m_vars.clear();
+
+      PolyFixture::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      cycle(
+         m_vars,
+         iterations,
+         tid,
+         [](auto& var, Value a, Value b)
+         {
+            std::visit([a, b](auto& o) { o.classMethod2(a, b); }, var);
+         }
+      );
+
+      Value s = 0;
+      for (auto& var: m_vars)
+         s += std::visit([](auto& o) { return o.v; }, var);
+
+      g_dontOptimize = s;
+      return 0;
+   }
+
+private:
+   std::vector<Variant> m_vars;
+};
+
+
+template <class Wrapper, auto Factory>
+class PolyWrappedMethod
+   : public PolyFixture
+{
+public:
+   using PolyFixture::PolyFixture;
+
+   void initialize(unsigned tid) override
+   {
+      PolyFixture::initialize(tid);
+
+      m_fns.reserve(m_objs.size());
+      for (auto& o: m_objs)
+         m_fns.push_back((o.get()->*Factory)());
+   }
+
+   void finalize() override
+   {
+      m_fns.clear();
+
+      PolyFixture::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      cycle(
+         m_fns,
+         iterations,
+         tid,
+         [](auto& fn, Value a, Value b) { fn(a, b); }
+      );
+
+      g_dontOptimize = sum();
+      return 0;
+   }
+
+private:
+   std::vector<Wrapper> m_fns;
+};
+
+
+class FunctionRefMethod final
+   : public WrappedMethod<Fixture::IObj::FnRef, &Fixture::IObj::functionRef>
+{
+};
+
+
+#if __cpp_lib_move_only_function
+class MoveOnlyFunctionMethod final
+   : public WrappedMethod<Fixture::IObj::MoveOnlyFn, &Fixture::IObj::moveOnlyMemberFn>
+{
+};
+#endif
+
+
+class DelegateMethod final
+   : public WrappedMethod<Fixture::IObj::DelegateFn, &Fixture::IObj::delegateMemberFn>
+{
+};
+
+
+class PolyStdFunctionMethod final
+   : public PolyWrappedMethod<Fixture::IObj::MemberFn, &Fixture::IObj::lambdaMemberFn>
+{
+public:
+   using PolyWrappedMethod::PolyWrappedMethod;
+};
+
+
+class PolyFunctionRefMethod final
+   : public PolyWrappedMethod<Fixture::IObj::FnRef, &Fixture::IObj::functionRef>
+{
+public:
+   using PolyWrappedMethod::PolyWrappedMethod;
+};
+
+
+#if __cpp_lib_move_only_function
+class PolyMoveOnlyFunctionMethod final
+   : public PolyWrappedMethod<Fixture::IObj::MoveOnlyFn, &Fixture::IObj::moveOnlyMemberFn>
+{
+public:
+   using PolyWrappedMethod::PolyWrappedMethod;
+};
+#endif
+
+
+class PolyDelegateMethod final
+   : public PolyWrappedMethod<Fixture::IObj::DelegateFn, &Fixture::IObj::delegateMemberFn>
+{
+public:
+   using PolyWrappedMethod::PolyWrappedMethod;
+};
+
+void addPolymorphic(
+   Benchmark::Runner& r,
+   Layout const& layout,
+   std::string_view prefix
+)
+{
+   auto name = [prefix](char const* what)
+   {
+      return std::string(prefix) + what;
+   };
+
+   r.add(
+      name("virtual method"),
+      Fixture::make<PolyVirtualMethod>(layout)
+   );
+
+   r.add(
+      name("final class + type switch"),
+      Fixture::make<PolyFinalMethod>(layout)
+   );
+
+   r.add(
+      name("CRTP, batched by type"),
+      Fixture::make<PolyCrtpMethod>(layout)
+   );
+
+   r.add(
+      name("std::variant + std::visit"),
+      Fixture::make<PolyVariantMethod>(layout)
+   );
+
+   r.add(
+      name("std::function + lambda -> regular method"),
+      Fixture::make<PolyStdFunctionMethod>(layout)
+   );
+
+   r.add(
+      name("function_ref -> regular method"),
+      Fixture::make<PolyFunctionRefMethod>(layout)
+   );
+
+#if __cpp_lib_move_only_function
+   r.add(
+      name("std::move_only_function -> regular method"),
+      Fixture::make<PolyMoveOnlyFunctionMethod>(layout)
+   );
+#endif
+
+   r.add(
+      name("small-buffer delegate -> regular method"),
+      Fixture::make<PolyDelegateMethod>(layout)
+   );
+}
+
 } // namespace
 
 
@@ -535,9 +1331,94 @@ int main(int argc, char** argv)
       Fixture::make<StdFunctionLambdaVirtualMethod>()
    );
 
+   r.add(
+      "final class -> virtual method",
+      Fixture::make<FinalMethod>()
+   );
+
+   r.add(
+      "CRTP method",
+      Fixture::make<CrtpMethod>()
+   );
+
+   r.add(
+      "std::variant + std::visit -> regular method",
+      Fixture::make<VariantMethod>()
+   );
+
+   r.add(
+      "function_ref -> regular method",
+      Fixture::make<FunctionRefMethod>()
+   );
+
+#if __cpp_lib_move_only_function
+   r.add(
+      "std::move_only_function -> regular method",
+      Fixture::make<MoveOnlyFunctionMethod>()
+   );
+#endif
+
+   r.add(
+      "small-buffer delegate -> regular method",
+      Fixture::make<DelegateMethod>()
+   );
+
+   addPolymorphic(r, Layout{}, "polymorphic: ");
 
    r.run();
 
+   // branch predictor mode: -t <max types> [-o sorted|periodic|random]
+   unsigned maxTypes = 0;
+   Benchmark::bindArg(
+      cmd,
+      "-t",
+      maxTypes,
+      "-t must be a number of types in [1, 8]"
+   );
+
+   if (maxTypes)
+   {
+      std::vector<Order> orders = { Order::Sorted, Order::Periodic, Order::Random };
+
+      std::string_view order;
+      if (cmd.get("-o", order) == Benchmark::CmdLine::ArgType::Ok)
+      {
+         auto it = std::find_if(
+            orders.begin(),
+            orders.end(),
+            [order](Order o) { return orderName(o) == order; }
+         );
+
+         if (it == orders.end())
+         {
+            std::cerr << "-o must be one of sorted, periodic, random\n";
+            return EXIT_FAILURE;
+         }
+
+         orders = { *it };
+      }
+
+      maxTypes = std::min(maxTypes, kMaxTypes);
+
+      for (auto o: orders)
+      {
+         for (unsigned types = 1; ; types = std::min(types * 2, maxTypes))
+         {
+            Benchmark::Runner rp(
+               "Polymorphic calls, " + std::to_string(types) + " type(s), " +
+                  std::string(orderName(o)) + " order",
+               iterations
+            );
+
+            addPolymorphic(rp, Layout{ types, o }, "");
+            rp.run();
+
+            if (types == maxTypes)
+               break;
+         }
+      }
+   }
+
    return 0;
 }
 
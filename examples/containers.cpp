@@ -0,0 +1,751 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if __has_include(<flat_map>)
+   #include <flat_map>
+#endif
+
+#include "benchmark/allocstats.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+
+BM_COUNT_ALLOCATIONS()
+
+
+namespace
+{
+
+
+using Value = std::uint64_t;
+
+
+inline std::uint64_t mix(std::uint64_t x) noexcept
+{
+   // splitmix64 finalizer, a bijection
+   x ^= x >> 30;
+   x *= 0xBF58476D1CE4E5B9ULL;
+   x ^= x >> 27;
+   x *= 0x94D049BB133111EBULL;
+   x ^= x >> 31;
+   return x;
+}
+
+
+struct Hash
+{
+   std::size_t operator()(std::uint64_t k) const noexcept
+   {
+      return mix(k);
+   }
+
+   std::size_t operator()(std::string const& k) const noexcept
+   {
+      return std::hash<std::string>{}(k);
+   }
+};
+
+
+// distinct keys; misses never collide with them
+template <typename Key>
+Key makeKey(std::uint64_t i, bool miss);
+
+template <>
+std::uint64_t makeKey<std::uint64_t>(std::uint64_t i, bool miss)
+{
+   return (mix(i) & ~std::uint64_t(1)) | (miss ? 1 : 0);
+}
+
+template <>
+std::string makeKey<std::string>(std::uint64_t i, bool miss)
+{
+   char buf[24];
+   std::snprintf(
+      buf,
+      sizeof(buf),
+      "%c%016llx",
+      miss ? 'm' : 'k',
+      static_cast<unsigned long long>(mix(i))
+   );
+
+   return buf;
+}
+
+
+// keys and lookup sequences shared by all fixtures of one table
+template <typename Key>
+struct Data
+{
+   Data(std::size_t size, std::size_t ops)
+   {
+      keys.reserve(size);
+      misses.reserve(size);
+      for (std::size_t i = 0; i < size; ++i)
+      {
+         keys.push_back(makeKey<Key>(i, false));
+         misses.push_back(makeKey<Key>(i, true));
+      }
+
+      Benchmark::Random r(size);
+      Benchmark::Zipf zipf(size);
+
+      auto const n = std::min(ops, kMaxSequence);
+      uniform.reserve(n);
+      skewed.reserve(n);
+      for (std::size_t i = 0; i < n; ++i)
+      {
+         uniform.push_back(std::uint32_t(r(size - 1)));
+         skewed.push_back(std::uint32_t(zipf(r)));
+      }
+   }
+
+   static constexpr std::size_t kMaxSequence = 16 * 1024 * 1024;
+
+   std::vector<Key> keys;
+   std::vector<Key> misses;
+   std::vector<std::uint32_t> uniform;
+   std::vector<std::uint32_t> skewed;
+};
+
+
+template <typename Key>
+class UnorderedMap final
+{
+public:
+   static constexpr bool kFlat = false;
+
+   void insert(Key const& k, Value v)
+   {
+      m_map.emplace(k, v);
+   }
+
+   void finish() {}
+
+   Value const* find(Key const& k) const noexcept
+   {
+      auto it = m_map.find(k);
+      return (it == m_map.end()) ? nullptr : &it->second;
+   }
+
+   void erase(Key const& k)
+   {
+      m_map.erase(k);
+   }
+
+   Value sum() const noexcept
+   {
+      Value s = 0;
+      for (auto& e: m_map)
+         s += e.second;
+      return s;
+   }
+
+   std::size_t size() const noexcept
+   {
+      return m_map.size();
+   }
+
+   void clear()
+   {
+      decltype(m_map) empty;
+      m_map.swap(empty);
+   }
+
+private:
+   std::unordered_map<Key, Value, Hash> m_map;
+};
+
+
+// bulk loaded: appends and sorts once on finish()
+template <typename Key>
+class SortedVector final
+{
+public:
+   static constexpr bool kFlat = true;
+
+   void insert(Key const& k, Value v)
+   {
+      m_v.emplace_back(k, v);
+   }
+
+   void finish()
+   {
+      std::sort(
+         m_v.begin(),
+         m_v.end(),
+         [](Entry const& a, Entry const& b) { return a.first < b.first; }
+      );
+   }
+
+   Value const* find(Key const& k) const noexcept
+   {
+      auto it = lowerBound(k);
+      return (it == m_v.end() || it->first != k) ? nullptr : &it->second;
+   }
+
+   void erase(Key const& k)
+   {
+      auto it = lowerBound(k);
+      if (it != m_v.end() && it->first == k)
+         m_v.erase(it);
+   }
+
+   Value sum() const noexcept
+   {
+      Value s = 0;
+      for (auto& e: m_v)
+         s += e.second;
+      return s;
+   }
+
+   std::size_t size() const noexcept
+   {
+      return m_v.size();
+   }
+
+   void clear()
+   {
+      decltype(m_v) empty;
+      m_v.swap(empty);
+   }
+
+private:
+   using Entry = std::pair<Key, Value>;
+
+   auto lowerBound(Key const& k) const noexcept
+   {
+      return std::lower_bound(
+         m_v.begin(),
+         m_v.end(),
+         k,
+         [](Entry const& e, Key const& k) { return e.first < k; }
+      );
+   }
+
+   std::vector<Entry> m_v;
+};
+
+
+#if __cpp_lib_flat_map
+
+// bulk loaded through a staging buffer
+template <typename Key>
+class FlatMap final
+{
+public:
+   static constexpr bool kFlat = true;
+
+   void insert(Key const& k, Value v)
+   {
+      m_staged.emplace_back(k, v);
+   }
+
+   void finish()
+   {
+      m_map.insert(m_staged.begin(), m_staged.end());
+
+      decltype(m_staged) empty;
+      m_staged.swap(empty);
+   }
+
+   Value const* find(Key const& k) const noexcept
+   {
+      auto it = m_map.find(k);
+      return (it == m_map.end()) ? nullptr : &it->second;
+   }
+
+   void erase(Key const& k)
+   {
+      m_map.erase(k);
+   }
+
+   Value sum() const noexcept
+   {
+      Value s = 0;
+      for (auto const& e: m_map)
+         s += e.second;
+      return s;
+   }
+
+   std::size_t size() const noexcept
+   {
+      return m_map.size();
+   }
+
+   void clear()
+   {
+      decltype(m_map) empty;
+      m_map.swap(empty);
+   }
+
+private:
+   std::flat_map<Key, Value> m_map;
+   std::vector<std::pair<Key, Value>> m_staged;
+};
+
+#endif
+
+
+// linear probing, power-of-two capacity, load factor <= 1/2,
+// backward shift deletion (no tombstones)
+template <typename Key>
+class OpenTable final
+{
+public:
+   static constexpr bool kFlat = false;
+
+   void insert(Key const& k, Value v)
+   {
+      if ((m_size + 1) * 2 > m_entries.size())
+         grow();
+
+      auto i = probe(k);
+      if (!m_used[i])
+      {
+         m_used[i] = 1;
+         m_entries[i] = Entry{ k, v };
+         ++m_size;
+      }
+   }
+
+   void finish() {}
+
+   Value const* find(Key const& k) const noexcept
+   {
+      if (!m_size)
+         return nullptr;
+
+      auto i = probe(k);
+      return m_used[i] ? &m_entries[i].value : nullptr;
+   }
+
+   void erase(Key const& k)
+   {
+      if (!m_size)
+         return;
+
+      auto i = probe(k);
+      if (!m_used[i])
+         return;
+
+      auto const mask = m_entries.size() - 1;
+      auto j = i;
+      for (;;)
+      {
+         j = (j + 1) & mask;
+         if (!m_used[j])
+            break;
+
+         auto home = Hash{}(m_entries[j].key) & mask;
+         if (((j - home) & mask) >= ((j - i) & mask))
+         {
+            m_entries[i] = std::move(m_entries[j]);
+            i = j;
+         }
+      }
+
+      m_used[i] = 0;
+      m_entries[i] = Entry{};
+      --m_size;
+   }
+
+   Value sum() const noexcept
+   {
+      Value s = 0;
+      for (std::size_t i = 0; i < m_entries.size(); ++i)
+      {
+         if (m_used[i])
+            s += m_entries[i].value;
+      }
+
+      return s;
+   }
+
+   std::size_t size() const noexcept
+   {
+      return m_size;
+   }
+
+   void clear()
+   {
+      decltype(m_entries) e;
+      m_entries.swap(e);
+      decltype(m_used) u;
+      m_used.swap(u);
+      m_size = 0;
+   }
+
+private:
+   struct Entry
+   {
+      Key key = {};
+      Value value = 0;
+   };
+
+   std::size_t probe(Key const& k) const noexcept
+   {
+      auto const mask = m_entries.size() - 1;
+      auto i = Hash{}(k) & mask;
+      while (m_used[i] && !(m_entries[i].key == k))
+         i = (i + 1) & mask;
+
+      return i;
+   }
+
+   void grow()
+   {
+      auto capacity = std::max<std::size_t>(16, m_entries.size() * 2);
+
+      std::vector<Entry> entries(capacity);
+      std::vector<std::uint8_t> used(capacity);
+      entries.swap(m_entries);
+      used.swap(m_used);
+      m_size = 0;
+
+      for (std::size_t i = 0; i < entries.size(); ++i)
+      {
+         if (used[i])
+         {
+            auto j = probe(entries[i].key);
+            m_used[j] = 1;
+            m_entries[j] = std::move(entries[i]);
+            ++m_size;
+         }
+      }
+   }
+
+   std::vector<Entry> m_entries;
+   std::vector<std::uint8_t> m_used;
+   std::size_t m_size = 0;
+};
+
+
+template <class Container, typename Key>
+class Fixture
+   : public Benchmark::Fixture
+{
+public:
+   Fixture(std::shared_ptr<Data<Key> const> data)
+      : m_data(std::move(data))
+   {}
+
+   void finalize() override
+   {
+      m_c.clear();
+   }
+
+protected:
+   void build()
+   {
+      auto& keys = m_data->keys;
+      for (std::size_t i = 0; i < keys.size(); ++i)
+         m_c.insert(keys[i], i);
+
+      m_c.finish();
+   }
+
+   static volatile Value g_dontOptimize;
+
+   std::shared_ptr<Data<Key> const> m_data;
+   Container m_c;
+};
+
+template <class Container, typename Key>
+volatile Value Fixture<Container, Key>::g_dontOptimize = 0;
+
+
+// builds the container from scratch, one key per operation; the heap
+// it takes is counted in an untimed build, so the timed inserts pay
+// nothing for the accounting
+template <class Container, typename Key>
+class Insert final
+   : public Fixture<Container, Key>
+{
+public:
+   using Fixture<Container, Key>::Fixture;
+
+   void initialize(unsigned) override
+   {
+      Benchmark::AllocStats::Scope counting;
+
+      auto bytes = Benchmark::AllocStats::bytes;
+      auto allocations = Benchmark::AllocStats::allocations;
+
+      this->build();
+
+      m_bytes = Benchmark::AllocStats::bytes - bytes;
+      m_allocations = Benchmark::AllocStats::allocations - allocations;
+
+      this->m_c.clear();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto& keys = this->m_data->keys;
+      auto n = std::min<std::size_t>(iterations, keys.size() - m_next);
+      for (std::size_t i = 0; i < n; ++i, ++m_next)
+         this->m_c.insert(keys[m_next], m_next);
+
+      if (m_next == keys.size())
+         this->m_c.finish();
+
+      return iterations - n;
+   }
+
+   void epilogue(Benchmark::Tid) override
+   {
+      if (m_next == this->m_data->keys.size())
+      {
+         this->m_c.clear();
+         m_next = 0;
+      }
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      auto const n = double(this->m_data->keys.size());
+      m.push_back({ "B/elem", double(m_bytes) / n });
+      m.push_back({ "allocations/elem", double(m_allocations) / n });
+   }
+
+   void finalize() override
+   {
+      Fixture<Container, Key>::finalize();
+      m_next = 0;
+   }
+
+private:
+   std::size_t m_next = 0;
+   std::int64_t m_bytes = 0;
+   std::uint64_t m_allocations = 0;
+};
+
+
+template <class Container, typename Key, bool Hit, bool Skewed>
+class Find final
+   : public Fixture<Container, Key>
+{
+public:
+   using Fixture<Container, Key>::Fixture;
+
+   void initialize(unsigned) override
+   {
+      this->build();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto& keys = Hit ? this->m_data->keys : this->m_data->misses;
+      auto& seq = Skewed ? this->m_data->skewed : this->m_data->uniform;
+
+      Value found = 0;
+      std::size_t pos = 0;
+      while (iterations--)
+      {
+         auto v = this->m_c.find(keys[seq[pos]]);
+         if (v)
+            found += *v;
+
+         if (++pos == seq.size())
+            pos = 0;
+      }
+
+      this->g_dontOptimize = found;
+      return 0;
+   }
+};
+
+
+// erases all the keys, one per operation
+template <class Container, typename Key>
+class Erase final
+   : public Fixture<Container, Key>
+{
+public:
+   using Fixture<Container, Key>::Fixture;
+
+   void prologue(Benchmark::Tid) override
+   {
+      if (!this->m_c.size())
+      {
+         this->build();
+         m_next = 0;
+      }
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto& keys = this->m_data->keys;
+      auto n = std::min<std::size_t>(iterations, keys.size() - m_next);
+      for (std::size_t i = 0; i < n; ++i, ++m_next)
+         this->m_c.erase(keys[keys.size() - 1 - m_next]);
+
+      return iterations - n;
+   }
+
+private:
+   std::size_t m_next = 0;
+};
+
+
+// one operation per element visited
+template <class Container, typename Key>
+class Iterate final
+   : public Fixture<Container, Key>
+{
+public:
+   using Fixture<Container, Key>::Fixture;
+
+   void initialize(unsigned) override
+   {
+      this->build();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto const n = std::max<std::size_t>(1, this->m_c.size());
+
+      Value s = 0;
+      while (iterations)
+      {
+         s += this->m_c.sum();
+         iterations -= std::min<Benchmark::Counter>(iterations, n);
+      }
+
+      this->g_dontOptimize = s;
+      return 0;
+   }
+};
+
+
+// element-wise erase from a flat container is O(size), so beyond
+// this size the erase row alone would take minutes
+constexpr std::size_t kMaxFlatErase = 4 * 1024;
+
+
+template <template <typename> class Container, typename Key>
+void add(
+   Benchmark::Runner& r,
+   std::string const& name,
+   std::shared_ptr<Data<Key> const> const& data
+)
+{
+   using C = Container<Key>;
+
+   r.add(
+      name + " insert",
+      Benchmark::Fixture::make<Insert<C, Key>>(data)
+   );
+
+   r.add(
+      name + " find (hit, uniform)",
+      Benchmark::Fixture::make<Find<C, Key, true, false>>(data)
+   );
+
+   r.add(
+      name + " find (hit, skewed)",
+      Benchmark::Fixture::make<Find<C, Key, true, true>>(data)
+   );
+
+   r.add(
+      name + " find (miss, uniform)",
+      Benchmark::Fixture::make<Find<C, Key, false, false>>(data)
+   );
+
+   r.add(
+      name + " find (miss, skewed)",
+      Benchmark::Fixture::make<Find<C, Key, false, true>>(data)
+   );
+
+   if (!C::kFlat || data->keys.size() <= kMaxFlatErase)
+   {
+      r.add(
+         name + " erase",
+         Benchmark::Fixture::make<Erase<C, Key>>(data)
+      );
+   }
+
+   r.add(
+      name + " iterate",
+      Benchmark::Fixture::make<Iterate<C, Key>>(data)
+   );
+}
+
+
+template <typename Key>
+void runTable(
+   std::string const& keyName,
+   std::size_t size,
+   std::uint64_t minOps
+)
+{
+   auto const ops = std::max<std::uint64_t>(minOps, size);
+   auto data = std::make_shared<Data<Key> const>(size, ops);
+
+   Benchmark::Runner r(
+      "Containers: " + keyName + " keys, " + std::to_string(size) + " elements",
+      ops
+   );
+
+   add<UnorderedMap, Key>(r, "std::unordered_map", data);
+   add<SortedVector, Key>(r, "sorted std::vector", data);
+#if __cpp_lib_flat_map
+   add<FlatMap, Key>(r, "std::flat_map", data);
+#endif
+   add<OpenTable, Key>(r, "open addressing", data);
+
+   r.run();
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+
+   // only Insert's untimed build counts
+   Benchmark::AllocStats::enabled = false;
+
+   std::uint64_t iterations = 1000000ULL;
+   std::size_t maxSize = 16 * 1024 * 1024;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   Benchmark::bindArg(
+      cmd,
+      "-m",
+      maxSize,
+      "-m must be a positive integer"
+   );
+
+   for (std::size_t size = 16; size <= maxSize; size *= 16)
+      runTable<std::uint64_t>("uint64_t", size, iterations);
+
+   for (std::size_t size = 16; size <= maxSize; size *= 16)
+      runTable<std::string>("std::string", size, iterations);
+
+   return 0;
+}
@@ -0,0 +1,714 @@
+//
+// C++20 coroutines: the cost of a resume next to ordinary calls, a
+// generator next to a hand-written iterator, and coroutine frames from
+// the global heap next to frames from a per-thread pool
+//
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<generator>)
+   #include <generator>
+#endif
+
+#include "benchmark/allocstats.hpp"
+#include "benchmark/benchmark.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+
+BM_COUNT_ALLOCATIONS()
+
+
+namespace
+{
+
+
+using Value = std::uint64_t;
+
+
+//
+// coroutine types
+//
+
+// runs forever, one step per resume()
+class Loop final
+{
+public:
+   struct promise_type
+   {
+      Loop get_return_object() noexcept
+      {
+         return Loop(Handle::from_promise(*this));
+      }
+
+      std::suspend_always initial_suspend() noexcept
+      {
+         return {};
+      }
+
+      std::suspend_always final_suspend() noexcept
+      {
+         return {};
+      }
+
+      void return_void() noexcept
+      {}
+
+      void unhandled_exception() noexcept
+      {
+         std::terminate();
+      }
+   };
+
+   using Handle = std::coroutine_handle<promise_type>;
+
+   Loop(Loop&& other) noexcept
+      : m_h(std::exchange(other.m_h, {}))
+   {}
+
+   ~Loop()
+   {
+      if (m_h)
+         m_h.destroy();
+   }
+
+   void resume()
+   {
+      m_h.resume();
+   }
+
+private:
+   explicit Loop(Handle h) noexcept
+      : m_h(h)
+   {}
+
+   Handle m_h;
+};
+
+
+// a minimal lazy generator with an input iterator
+template <typename T>
+class Generator final
+{
+public:
+   struct promise_type
+   {
+      Generator get_return_object() noexcept
+      {
+         return Generator(Handle::from_promise(*this));
+      }
+
+      std::suspend_always initial_suspend() noexcept
+      {
+         return {};
+      }
+
+      std::suspend_always final_suspend() noexcept
+      {
+         return {};
+      }
+
+      std::suspend_always yield_value(T v) noexcept
+      {
+         value = v;
+         return {};
+      }
+
+      void return_void() noexcept
+      {}
+
+      void unhandled_exception() noexcept
+      {
+         std::terminate();
+      }
+
+      T value{};
+   };
+
+   using Handle = std::coroutine_handle<promise_type>;
+
+   class iterator
+   {
+   public:
+      using value_type = T;
+      using difference_type = std::ptrdiff_t;
+
+      iterator() noexcept = default;
+
+      explicit iterator(Handle h) noexcept
+         : m_h(h)
+      {}
+
+      T const& operator*() const noexcept
+      {
+         return m_h.promise().value;
+      }
+
+      iterator& operator++()
+      {
+         m_h.resume();
+         return *this;
+      }
+
+      void operator++(int)
+      {
+         ++*this;
+      }
+
+      bool operator==(std::default_sentinel_t) const noexcept
+      {
+         return m_h.done();
+      }
+
+   private:
+      Handle m_h;
+   };
+
+   Generator(Generator&& other) noexcept
+      : m_h(std::exchange(other.m_h, {}))
+   {}
+
+   ~Generator()
+   {
+      if (m_h)
+         m_h.destroy();
+   }
+
+   iterator begin()
+   {
+      m_h.resume();
+      return iterator(m_h);
+   }
+
+   std::default_sentinel_t end() const noexcept
+   {
+      return {};
+   }
+
+private:
+   explicit Generator(Handle h) noexcept
+      : m_h(h)
+   {}
+
+   Handle m_h;
+};
+
+
+//
+// per-thread free lists of coroutine frames in 64-byte size classes;
+// a frame destroyed on another thread joins that thread's list
+//
+class FramePool final
+{
+public:
+   static void* allocate(std::size_t n)
+   {
+      auto c = sizeClass(n);
+      if (c >= kClasses)
+         return ::operator new(n);
+
+      auto& head = local().m_free[c];
+      if (auto node = head)
+      {
+         head = node->next;
+         return node;
+      }
+
+      return ::operator new((c + 1) * kGranularity);
+   }
+
+   static void deallocate(void* p, std::size_t n) noexcept
+   {
+      auto c = sizeClass(n);
+      if (c >= kClasses)
+      {
+         ::operator delete(p);
+         return;
+      }
+
+      auto& head = local().m_free[c];
+      head = ::new (p) Node{ head };
+   }
+
+private:
+   static constexpr std::size_t kGranularity = 64;
+   static constexpr std::size_t kClasses = 16;
+
+   struct Node
+   {
+      Node* next;
+   };
+
+   FramePool() noexcept = default;
+
+   ~FramePool()
+   {
+      for (auto head: m_free)
+      {
+         while (head)
+            ::operator delete(std::exchange(head, head->next));
+      }
+   }
+
+   static std::size_t sizeClass(std::size_t n) noexcept
+   {
+      return (n + kGranularity - 1) / kGranularity - 1;
+   }
+
+   static FramePool& local() noexcept
+   {
+      thread_local FramePool pool;
+      return pool;
+   }
+
+   Node* m_free[kClasses] = {};
+};
+
+
+// promise base routing the frame allocation through FramePool
+struct PooledFrame
+{
+   static void* operator new(std::size_t n)
+   {
+      return FramePool::allocate(n);
+   }
+
+   static void operator delete(void* p, std::size_t n) noexcept
+   {
+      FramePool::deallocate(p, n);
+   }
+};
+
+struct HeapFrame
+{};
+
+
+// lazily started, run to completion by get()
+template <class Frame>
+class Task final
+{
+public:
+   struct promise_type
+      : public Frame
+   {
+      Task get_return_object() noexcept
+      {
+         return Task(Handle::from_promise(*this));
+      }
+
+      std::suspend_always initial_suspend() noexcept
+      {
+         return {};
+      }
+
+      std::suspend_always final_suspend() noexcept
+      {
+         return {};
+      }
+
+      void return_value(Value v) noexcept
+      {
+         value = v;
+      }
+
+      void unhandled_exception() noexcept
+      {
+         std::terminate();
+      }
+
+      Value value = 0;
+   };
+
+   using Handle = std::coroutine_handle<promise_type>;
+
+   Task(Task&& other) noexcept
+      : m_h(std::exchange(other.m_h, {}))
+   {}
+
+   ~Task()
+   {
+      if (m_h)
+         m_h.destroy();
+   }
+
+   Value get()
+   {
+      m_h.resume();
+      return m_h.promise().value;
+   }
+
+private:
+   explicit Task(Handle h) noexcept
+      : m_h(h)
+   {}
+
+   Handle m_h;
+};
+
+
+//
+// the work: one step of an accumulation, and a pseudo-random sequence
+//
+
+BM_NOINLINE void step(Value& v, Value x) noexcept
+{
+   v += x;
+}
+
+struct IStep
+{
+   virtual ~IStep() = default;
+   virtual void step(Value& v, Value x) noexcept = 0;
+};
+
+struct Step final
+   : public IStep
+{
+   BM_NOINLINE void step(Value& v, Value x) noexcept override
+   {
+      v += x;
+   }
+};
+
+Loop accumulate(Value& v, Value x)
+{
+   for (;;)
+   {
+      v += x;
+      co_await std::suspend_always{};
+   }
+}
+
+
+Generator<Value> randoms(Value seed)
+{
+   Benchmark::Random r(seed);
+   for (;;)
+      co_yield r();
+}
+
+#if __cpp_lib_generator
+
+std::generator<Value> stdRandoms(Value seed)
+{
+   Benchmark::Random r(seed);
+   for (;;)
+      co_yield r();
+}
+
+#endif
+
+// the same sequence, hand-written
+class RandomIterator final
+{
+public:
+   using value_type = Value;
+   using difference_type = std::ptrdiff_t;
+
+   explicit RandomIterator(Value seed) noexcept
+      : m_rand(seed)
+      , m_value(m_rand())
+   {}
+
+   Value operator*() const noexcept
+   {
+      return m_value;
+   }
+
+   RandomIterator& operator++() noexcept
+   {
+      m_value = m_rand();
+      return *this;
+   }
+
+private:
+   Benchmark::Random m_rand;
+   Value m_value;
+};
+
+
+template <class Frame>
+Task<Frame> square(Value x)
+{
+   co_return x * x + 1;
+}
+
+BM_NOINLINE Value squareCall(Value x) noexcept
+{
+   return x * x + 1;
+}
+
+
+//
+// fixtures; an iteration is one call, one resume or one value
+//
+
+class Fixture
+   : public Benchmark::Fixture
+{
+protected:
+   static volatile Value g_dontOptimize;
+};
+
+volatile Value Fixture::g_dontOptimize = 0;
+
+
+class FunctionCall final
+   : public Fixture
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      Value v = 0;
+      while (iterations--)
+         step(v, tid + 1);
+
+      g_dontOptimize = v;
+      return 0;
+   }
+};
+
+
+class VirtualCall final
+   : public Fixture
+{
+public:
+   VirtualCall()
+      : m_obj(std::make_unique<Step>())
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      auto o = m_obj.get();
+      Value v = 0;
+      while (iterations--)
+         o->step(v, tid + 1);
+
+      g_dontOptimize = v;
+      return 0;
+   }
+
+private:
+   std::unique_ptr<IStep> m_obj;
+};
+
+
+class StdFunctionCall final
+   : public Fixture
+{
+public:
+   StdFunctionCall()
+      : m_fn(step)
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      Value v = 0;
+      while (iterations--)
+         m_fn(v, tid + 1);
+
+      g_dontOptimize = v;
+      return 0;
+   }
+
+private:
+   std::function<void(Value&, Value)> m_fn;
+};
+
+
+class CoroutineResume final
+   : public Fixture
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      Value v = 0;
+      auto loop = accumulate(v, tid + 1);
+      while (iterations--)
+         loop.resume();
+
+      g_dontOptimize = v;
+      return 0;
+   }
+};
+
+
+class IteratorSum final
+   : public Fixture
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      Value sum = 0;
+      RandomIterator it(tid + 1);
+      while (iterations--)
+      {
+         sum += *it;
+         ++it;
+      }
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+};
+
+
+template <auto Make>
+class GeneratorSum final
+   : public Fixture
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      Value sum = 0;
+      auto g = Make(tid + 1);
+      auto it = g.begin();
+      while (iterations--)
+      {
+         sum += *it;
+         ++it;
+      }
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+};
+
+
+// a coroutine created, run and destroyed per iteration; the heap
+// allocations per coroutine come from an untimed pass, so the timed
+// frames from operator new pay nothing for the accounting
+template <class Frame>
+class Spawn final
+   : public Fixture
+{
+public:
+   void initialize(unsigned) override
+   {
+      // once to warm the pool up, once to count the steady state
+      spawn(kSample);
+
+      Benchmark::AllocStats::Scope counting;
+      auto before = Benchmark::AllocStats::allocations;
+      spawn(kSample);
+      m_allocations = Benchmark::AllocStats::allocations - before;
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      g_dontOptimize = spawn(iterations);
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({
+         "allocations/coroutine",
+         double(m_allocations) / double(kSample)
+      });
+   }
+
+private:
+   static constexpr Value kSample = 1024;
+
+   static Value spawn(Value n)
+   {
+      Value sum = 0;
+      for (Value i = 0; i < n; ++i)
+      {
+         if constexpr (std::is_void_v<Frame>)
+            sum += squareCall(i);
+         else
+            sum += square<Frame>(i).get();
+      }
+
+      return sum;
+   }
+
+   std::uint64_t m_allocations = 0;
+};
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t iterations = 100000000ULL;
+
+   // only Spawn's untimed pass counts
+   Benchmark::AllocStats::enabled = false;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   {
+      Benchmark::Runner r("Resume vs call", iterations);
+
+      r.add("function call", Benchmark::Fixture::make<FunctionCall>());
+      r.add("virtual call", Benchmark::Fixture::make<VirtualCall>());
+      r.add("std::function call", Benchmark::Fixture::make<StdFunctionCall>());
+      r.add("coroutine resume", Benchmark::Fixture::make<CoroutineResume>());
+
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Generator vs iterator", iterations);
+
+      r.add("hand-written iterator", Benchmark::Fixture::make<IteratorSum>());
+      r.add("Generator", Benchmark::Fixture::make<GeneratorSum<randoms>>());
+#if __cpp_lib_generator
+      r.add("std::generator", Benchmark::Fixture::make<GeneratorSum<stdRandoms>>());
+#endif
+
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Coroutine frame allocation", iterations / 10);
+
+      r.add("function call", Benchmark::Fixture::make<Spawn<void>>());
+      r.add("coroutine, operator new", Benchmark::Fixture::make<Spawn<HeapFrame>>());
+      r.add("coroutine, per-thread frame pool", Benchmark::Fixture::make<Spawn<PooledFrame>>());
+
+      r.run();
+   }
+
+   return 0;
+}
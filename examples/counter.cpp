@@ -1,8 +1,21 @@
+//
+// a shared counter incremented by 1-8 threads, with a calibrated payload
+// of work between increments; one table per payload, so the cost of
+// each scheme reads as a curve over the payload
+//
+//    counter [-n <iterations>] [--payload <ns>,<ns>,...]
+//
+
 #include <atomic>
-#include <cmath>
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
 
-#include "benchmark/random.hpp"
+#include "benchmark/payload.hpp"
 #include "benchmark/runner.hpp"
 #include "benchmark/util.hpp"
 
@@ -15,26 +28,25 @@ class Fixture
    : public Benchmark::Fixture
 {
 public:
-   Fixture()
-      : m_rand(Benchmark::tid())
+   Fixture(Benchmark::Payload payload)
+      : m_payload(payload)
    {}
 
 protected:
    using Counter = std::int64_t;
 
-   Counter heavyFun() noexcept
+   // the payload, and 0 or 1 to add; each payload starts from the
+   // last one's result, so the core cannot overlap them; the chain is
+   // a local of each thread's run(), so only the counter is shared
+   Counter heavyFun(std::uint64_t& seed) const noexcept
    {
-      return static_cast<Counter>(
-         std::floor(
-            std::sin(m_rand()) *
-            std::cos(m_rand())
-         )
-      ) & 1;
+      seed = m_payload(seed + 1);
+      return static_cast<Counter>(seed & 1);
    }
 
    static volatile Counter g_dontOptimize;
 
-   Benchmark::Random m_rand;
+   Benchmark::Payload const m_payload;
 };
 
 volatile Fixture::Counter Fixture::g_dontOptimize = 0;
@@ -44,16 +56,17 @@ class NonAtomic
    : public Fixture
 {
 public:
-   NonAtomic() = default;
+   using Fixture::Fixture;
 
    Benchmark::Counter run(
       Benchmark::Counter iterations,
       Benchmark::Tid tid
    ) override
    {
+      std::uint64_t seed = tid + 1;
       while (iterations--)
       {
-         m_counter += heavyFun();
+         m_counter += heavyFun(seed);
       }
 
       g_dontOptimize = m_counter;
@@ -69,16 +82,17 @@ class NonAtomicVolatile
    : public Fixture
 {
 public:
-   NonAtomicVolatile() = default;
+   using Fixture::Fixture;
 
    Benchmark::Counter run(
       Benchmark::Counter iterations,
       Benchmark::Tid tid
    ) override
    {
+      std::uint64_t seed = tid + 1;
       while (iterations--)
       {
-         m_counter = m_counter + heavyFun();
+         m_counter = m_counter + heavyFun(seed);
       }
 
       g_dontOptimize = m_counter;
@@ -95,17 +109,18 @@ class Atomic
    : public Fixture
 {
 public:
-   Atomic() = default;
+   using Fixture::Fixture;
 
    Benchmark::Counter run(
       Benchmark::Counter iterations,
       Benchmark::Tid tid
    ) override
    {
+      std::uint64_t seed = tid + 1;
       while (iterations--)
       {
          m_counter.fetch_add(
-            heavyFun(),
+            heavyFun(seed),
             Order
          );
       }
@@ -123,16 +138,17 @@ class Mutex
    : public Fixture
 {
 public:
-   Mutex() = default;
+   using Fixture::Fixture;
 
    Benchmark::Counter run(
       Benchmark::Counter iterations,
       Benchmark::Tid tid
    ) override
    {
+      std::uint64_t seed = tid + 1;
       while (iterations--)
       {
-         auto t = heavyFun();
+         auto t = heavyFun(seed);
 
          std::lock_guard l(m_mu);
          m_counter += t;
@@ -147,6 +163,35 @@ private:
    Counter m_counter = 0;
 };
 
+
+// "0,20,100"; false on an empty, negative or malformed entry
+bool parseList(std::string_view list, std::vector<double>& values)
+{
+   values.clear();
+
+   std::size_t pos = 0;
+   for (;;)
+   {
+      auto end = list.find(',', pos);
+      if (end == std::string_view::npos)
+         end = list.size();
+
+      double v = 0;
+      auto first = list.data() + pos;
+      auto last = list.data() + end;
+      auto [ptr, ec] = std::from_chars(first, last, v);
+      if (ec != std::errc() || ptr != last || first == last || v < 0)
+         return false;
+
+      values.push_back(v);
+      if (end == list.size())
+         return true;
+
+      pos = end + 1;
+   }
+}
+
+
 } // namespace
 
 
@@ -162,48 +207,72 @@ int main(int argc, char** argv)
       "-n must be a positive integer"
    );
 
-   Benchmark::Runner r(
-      "Counter performance",
-      iterations
-   );
-
-
-   r.add(
-      "non-atomic counter",
-      Benchmark::Fixture::make<NonAtomic>()
-   );
-
-   r.add(
-      "non-atomic volatile counter",
-      Benchmark::Fixture::make<NonAtomicVolatile>()
-   );
-
-   r.add(
-      "atomic counter (relaxed)",
-      Benchmark::Fixture::make<Atomic<std::memory_order_relaxed>>(),
-      { 1, 2, 4, 8 }
-   );
-
-   r.add(
-      "atomic counter (acq_rel)",
-      Benchmark::Fixture::make<Atomic<std::memory_order_acq_rel>>(),
-      { 1, 2, 4, 8 }
-   );
-
-   r.add(
-      "atomic counter (seq_cst)",
-      Benchmark::Fixture::make<Atomic<std::memory_order_seq_cst>>(),
-      { 1, 2, 4, 8 }
-   );
-
-   r.add(
-      "mutex + counter",
-      Benchmark::Fixture::make<Mutex>(),
-      { 1, 2, 4, 8 }
-   );
+   // ns of work between increments
+   std::vector<double> payloads = { 0, 20, 100, 500 };
+   std::string_view list;
+   if (
+      cmd.get("--payload", list) == Benchmark::CmdLine::ArgType::Ok &&
+      !parseList(list, payloads)
+      )
+   {
+      std::cerr << "--payload must be a comma-separated list of ns\n";
+      return EXIT_FAILURE;
+   }
 
-   r.run();
+   for (auto ns: payloads)
+   {
+      Benchmark::Payload payload(ns);
+
+      // -n is for no payload; longer ones run proportionally fewer
+      // iterations, so every table takes a similar time
+      constexpr double kReferenceNs = 20;
+      auto n = std::max<std::uint64_t>(
+         1000,
+         std::uint64_t(double(iterations) * kReferenceNs / (kReferenceNs + payload.ns()))
+      );
+
+      Benchmark::Runner r(
+         "Counter performance, payload " + std::to_string(std::uint64_t(payload.ns() + 0.5)) +
+            " ns (" + std::to_string(payload.steps()) + " dependent steps)",
+         n
+      );
+
+      r.add(
+         "non-atomic counter",
+         Benchmark::Fixture::make<NonAtomic>(payload)
+      );
+
+      r.add(
+         "non-atomic volatile counter",
+         Benchmark::Fixture::make<NonAtomicVolatile>(payload)
+      );
+
+      r.add(
+         "atomic counter (relaxed)",
+         Benchmark::Fixture::make<Atomic<std::memory_order_relaxed>>(payload),
+         { 1, 2, 4, 8 }
+      );
+
+      r.add(
+         "atomic counter (acq_rel)",
+         Benchmark::Fixture::make<Atomic<std::memory_order_acq_rel>>(payload),
+         { 1, 2, 4, 8 }
+      );
+
+      r.add(
+         "atomic counter (seq_cst)",
+         Benchmark::Fixture::make<Atomic<std::memory_order_seq_cst>>(payload),
+         { 1, 2, 4, 8 }
+      );
+
+      r.add(
+         "mutex + counter",
+         Benchmark::Fixture::make<Mutex>(payload),
+         { 1, 2, 4, 8 }
+      );
+
+      r.run();
+   }
 
    return 0;
 }
-
@@ -0,0 +1,878 @@
+//
+// file read paths over a temporary file:
+//
+//    fileio [-s <file MB>] [-d <directory>] [-w]
+//
+// the page cache is dropped before every run unless -w (warm) is given
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/histogram.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+#if BM_POSIX
+   #include <fcntl.h>
+   #include <linux/io_uring.h>
+   #include <sys/mman.h>
+   #include <sys/syscall.h>
+   #include <unistd.h>
+#endif
+
+
+namespace
+{
+
+
+constexpr std::size_t kAlignment = 4096;
+
+
+struct AlignedDeleter
+{
+   void operator()(char* p) const noexcept
+   {
+      std::free(p);
+   }
+};
+
+using AlignedBuffer = std::unique_ptr<char, AlignedDeleter>;
+
+AlignedBuffer alignedBuffer(std::size_t size)
+{
+   return AlignedBuffer(
+      static_cast<char*>(std::aligned_alloc(kAlignment, size))
+   );
+}
+
+
+// a file of pseudo-random bytes, removed on destruction
+class TempFile final
+{
+public:
+   TempFile(std::filesystem::path const& dir, std::uint64_t size)
+      : m_size(size)
+   {
+      auto pattern = (dir / "bm_fileio_XXXXXX").string();
+      auto fd = ::mkstemp(pattern.data());
+      if (fd < 0)
+         return;
+
+      m_path = pattern;
+
+      constexpr std::size_t kChunk = 1024 * 1024;
+      auto chunk = alignedBuffer(kChunk);
+      Benchmark::Random r(size);
+      auto words = reinterpret_cast<std::uint64_t*>(chunk.get());
+      for (std::size_t i = 0; i < kChunk / sizeof(std::uint64_t); ++i)
+         words[i] = r();
+
+      for (std::uint64_t written = 0; written < size; )
+      {
+         auto n = std::min<std::uint64_t>(kChunk, size - written);
+         auto w = ::write(fd, chunk.get(), n);
+         if (w <= 0)
+         {
+            ::unlink(m_path.c_str());
+            m_path.clear();
+            break;
+         }
+
+         written += std::uint64_t(w);
+      }
+
+      ::fdatasync(fd);
+      ::close(fd);
+   }
+
+   ~TempFile()
+   {
+      if (!m_path.empty())
+         ::unlink(m_path.c_str());
+   }
+
+   bool valid() const noexcept
+   {
+      return !m_path.empty();
+   }
+
+   char const* path() const noexcept
+   {
+      return m_path.c_str();
+   }
+
+   std::uint64_t size() const noexcept
+   {
+      return m_size;
+   }
+
+   // evicts the file from the page cache
+   void drop() const noexcept
+   {
+      auto fd = ::open(path(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+         return;
+
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      ::close(fd);
+   }
+
+private:
+   std::string m_path;
+   std::uint64_t m_size;
+};
+
+
+enum class Pattern
+{
+   Sequential,
+   Random
+};
+
+
+struct Params
+{
+   TempFile const* file;
+   std::size_t block;
+   Pattern pattern;
+   bool warm;
+};
+
+
+//
+// every thread reads Runner iterations blocks: sequentially from its
+// share of the file on, wrapping around, or at random block offsets
+//
+class Fixture
+   : public Benchmark::Fixture
+{
+public:
+   Fixture(Params const& params) noexcept
+      : m_params(params)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      if (!m_params.warm)
+         m_params.file->drop();
+
+      m_threads = threads;
+      m_buffers.clear();
+      for (unsigned i = 0; i < threads; ++i)
+         m_buffers.push_back(alignedBuffer(m_params.block * depth()));
+
+      m_latencies = std::vector<Benchmark::Histogram>(threads);
+      m_bytes = 0;
+   }
+
+   void finalize() override
+   {
+      m_buffers.clear();
+      m_latencies.clear();
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({
+         "MB/s",
+         double(m_bytes.load(std::memory_order_relaxed)) / 1e6,
+         Benchmark::Metric::Kind::Rate
+      });
+
+      Benchmark::Histogram all;
+      for (auto& h: m_latencies)
+         all.merge(h);
+
+      all.report(m);
+   }
+
+protected:
+   struct Cursor
+   {
+      std::uint64_t block;
+      Benchmark::Random rand;
+   };
+
+   // the buffer holds this many blocks
+   virtual unsigned depth() const noexcept
+   {
+      return 1;
+   }
+
+   std::uint64_t blocks() const noexcept
+   {
+      return m_params.file->size() / m_params.block;
+   }
+
+   Cursor start(Benchmark::Tid tid) const noexcept
+   {
+      return Cursor{ tid * blocks() / m_threads, Benchmark::Random(tid + 1) };
+   }
+
+   std::uint64_t next(Cursor& c) const noexcept
+   {
+      std::uint64_t block;
+      if (m_params.pattern == Pattern::Sequential)
+      {
+         block = c.block;
+         if (++c.block == blocks())
+            c.block = 0;
+      }
+      else
+      {
+         block = c.rand(blocks() - 1);
+      }
+
+      return block * m_params.block;
+   }
+
+   void done(std::uint64_t bytes) noexcept
+   {
+      m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+   }
+
+   int openFile(int flags) const noexcept
+   {
+      return ::open(m_params.file->path(), O_RDONLY | O_CLOEXEC | flags);
+   }
+
+   Params const m_params;
+   unsigned m_threads = 1;
+   std::vector<AlignedBuffer> m_buffers;
+   std::vector<Benchmark::Histogram> m_latencies;
+
+private:
+   std::atomic<std::uint64_t> m_bytes = 0;
+};
+
+
+// one block read per iteration, waited for before the next one
+template <class Base>
+class Blocking
+   : public Base
+{
+public:
+   using Base::Base;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      Benchmark::TimestampProvider clock;
+      auto cursor = this->start(tid);
+      auto buf = this->m_buffers[tid].get();
+      auto& latencies = this->m_latencies[tid];
+
+      std::uint64_t bytes = 0;
+      while (iterations--)
+      {
+         auto started = clock();
+         bytes += readAt(tid, this->next(cursor), buf);
+         latencies.record((clock() - started).count());
+      }
+
+      this->done(bytes);
+      return 0;
+   }
+
+protected:
+   // reads a block at offset into buf, returns the bytes read
+   virtual std::size_t readAt(Benchmark::Tid tid, std::uint64_t offset, char* buf) = 0;
+};
+
+
+// a descriptor per thread
+class PerThreadFd
+   : public Fixture
+{
+public:
+   PerThreadFd(Params const& params, int flags = 0) noexcept
+      : Fixture(params)
+      , m_flags(flags)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      Fixture::initialize(threads);
+
+      m_fds.clear();
+      for (unsigned i = 0; i < threads; ++i)
+         m_fds.push_back(openFile(m_flags));
+   }
+
+   void finalize() override
+   {
+      for (auto fd: m_fds)
+         ::close(fd);
+
+      m_fds.clear();
+
+      Fixture::finalize();
+   }
+
+protected:
+   int const m_flags;
+   std::vector<int> m_fds;
+};
+
+
+// read() from the current position; sequential only
+class Read final
+   : public Blocking<PerThreadFd>
+{
+public:
+   using Blocking::Blocking;
+
+   void initialize(unsigned threads) override
+   {
+      Blocking::initialize(threads);
+
+      for (unsigned i = 0; i < threads; ++i)
+         ::lseek(m_fds[i], off_t(start(i).block * m_params.block), SEEK_SET);
+   }
+
+protected:
+   std::size_t readAt(Benchmark::Tid tid, std::uint64_t, char* buf) override
+   {
+      auto r = ::read(m_fds[tid], buf, m_params.block);
+      if (r == 0)
+      {
+         ::lseek(m_fds[tid], 0, SEEK_SET);
+         r = ::read(m_fds[tid], buf, m_params.block);
+      }
+
+      return r > 0 ? std::size_t(r) : 0;
+   }
+};
+
+
+// pread(), buffered or with O_DIRECT
+class Pread final
+   : public Blocking<PerThreadFd>
+{
+public:
+   using Blocking::Blocking;
+
+protected:
+   std::size_t readAt(Benchmark::Tid tid, std::uint64_t offset, char* buf) override
+   {
+      auto r = ::pread(m_fds[tid], buf, m_params.block, off_t(offset));
+      return r > 0 ? std::size_t(r) : 0;
+   }
+};
+
+
+// copies the block out of a shared mapping; with MAP_POPULATE every
+// thread maps the file itself inside the timed run, since prefaulting
+// it in initialize() would read it in untimed, after the cache drop
+class Mmap final
+   : public Blocking<Fixture>
+{
+public:
+   Mmap(Params const& params, int advice, bool populate) noexcept
+      : Blocking(params)
+      , m_advice(advice)
+      , m_populate(populate)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      Blocking::initialize(threads);
+
+      m_bases.assign(threads, nullptr);
+      if (!m_populate)
+         m_bases.assign(threads, map());
+   }
+
+   void finalize() override
+   {
+      if (!m_populate && !m_bases.empty())
+         unmap(m_bases.front());
+
+      m_bases.clear();
+
+      Blocking::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      if (!m_populate)
+         return Blocking::run(iterations, tid);
+
+      m_bases[tid] = map();
+      auto left = Blocking::run(iterations, tid);
+      unmap(std::exchange(m_bases[tid], nullptr));
+      return left;
+   }
+
+protected:
+   std::size_t readAt(Benchmark::Tid tid, std::uint64_t offset, char* buf) override
+   {
+      auto base = m_bases[tid];
+      if (!base)
+         return 0;
+
+      std::memcpy(buf, base + offset, m_params.block);
+      return m_params.block;
+   }
+
+private:
+   char const* map() const noexcept
+   {
+      auto fd = openFile(0);
+      auto p = ::mmap(
+         nullptr,
+         m_params.file->size(),
+         PROT_READ,
+         MAP_SHARED | (m_populate ? MAP_POPULATE : 0),
+         fd,
+         0
+      );
+
+      ::close(fd);
+
+      if (p == MAP_FAILED)
+         return nullptr;
+
+      if (m_advice != MADV_NORMAL)
+         ::madvise(p, m_params.file->size(), m_advice);
+
+      return static_cast<char const*>(p);
+   }
+
+   void unmap(char const* base) const noexcept
+   {
+      if (base)
+         ::munmap(const_cast<char*>(base), m_params.file->size());
+   }
+
+   int const m_advice;
+   bool const m_populate;
+   std::vector<char const*> m_bases;
+};
+
+
+//
+// io_uring through the raw system calls: every thread keeps up to
+// depth reads in flight and resubmits completed ones in one batch
+//
+
+class Ring final
+{
+public:
+   Ring() noexcept = default;
+
+   Ring(Ring const&) = delete;
+   Ring& operator=(Ring const&) = delete;
+
+   ~Ring()
+   {
+      if (m_sq != MAP_FAILED)
+         ::munmap(m_sq, m_sqSize);
+      if (m_cq != MAP_FAILED && m_cq != m_sq)
+         ::munmap(m_cq, m_cqSize);
+      if (m_sqes != MAP_FAILED)
+         ::munmap(m_sqes, m_sqesSize);
+      if (m_fd >= 0)
+         ::close(m_fd);
+   }
+
+   static bool supported() noexcept
+   {
+      Ring r;
+      return r.setup(1);
+   }
+
+   bool setup(unsigned entries) noexcept
+   {
+      io_uring_params p = {};
+      m_fd = int(::syscall(__NR_io_uring_setup, entries, &p));
+      if (m_fd < 0)
+         return false;
+
+      m_sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+      m_cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+      bool const single = (p.features & IORING_FEAT_SINGLE_MMAP);
+      if (single)
+         m_sqSize = m_cqSize = std::max(m_sqSize, m_cqSize);
+
+      m_sq = ::mmap(
+         nullptr, m_sqSize, PROT_READ | PROT_WRITE,
+         MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING
+      );
+
+      if (m_sq == MAP_FAILED)
+         return false;
+
+      m_cq = single ?
+         m_sq :
+         ::mmap(
+            nullptr, m_cqSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING
+         );
+
+      if (m_cq == MAP_FAILED)
+         return false;
+
+      m_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+      m_sqes = ::mmap(
+         nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+         MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES
+      );
+
+      if (m_sqes == MAP_FAILED)
+         return false;
+
+      auto sq = static_cast<char*>(m_sq);
+      m_sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+      m_sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+      m_sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+
+      auto cq = static_cast<char*>(m_cq);
+      m_cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+      m_cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+      m_cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+      m_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+      return true;
+   }
+
+   void read(int fd, char* buf, std::size_t size, std::uint64_t offset, std::uint64_t userData) noexcept
+   {
+      auto tail = *m_sqTail;
+      auto index = tail & m_sqMask;
+      auto sqe = static_cast<io_uring_sqe*>(m_sqes) + index;
+
+      std::memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = fd;
+      sqe->addr = reinterpret_cast<std::uint64_t>(buf);
+      sqe->len = unsigned(size);
+      sqe->off = offset;
+      sqe->user_data = userData;
+
+      m_sqArray[index] = index;
+      __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+      ++m_pending;
+   }
+
+   // submits the queued reads and waits for at least minComplete completions
+   bool enter(unsigned minComplete) noexcept
+   {
+      auto r = ::syscall(
+         __NR_io_uring_enter,
+         m_fd,
+         m_pending,
+         minComplete,
+         minComplete ? IORING_ENTER_GETEVENTS : 0,
+         nullptr,
+         0
+      );
+
+      if (r < 0)
+         return false;
+
+      m_pending -= unsigned(r);
+      return true;
+   }
+
+   template <class F>
+   unsigned reap(F&& f) noexcept
+   {
+      auto head = *m_cqHead;
+      auto tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+      unsigned n = 0;
+      for (; head != tail; ++head, ++n)
+         f(m_cqes[head & m_cqMask]);
+
+      __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+      return n;
+   }
+
+private:
+   int m_fd = -1;
+   void* m_sq = MAP_FAILED;
+   void* m_cq = MAP_FAILED;
+   void* m_sqes = MAP_FAILED;
+   std::size_t m_sqSize = 0;
+   std::size_t m_cqSize = 0;
+   std::size_t m_sqesSize = 0;
+
+   unsigned* m_sqTail = nullptr;
+   unsigned m_sqMask = 0;
+   unsigned* m_sqArray = nullptr;
+   unsigned* m_cqHead = nullptr;
+   unsigned* m_cqTail = nullptr;
+   unsigned m_cqMask = 0;
+   io_uring_cqe* m_cqes = nullptr;
+
+   unsigned m_pending = 0;
+};
+
+
+class Uring final
+   : public PerThreadFd
+{
+public:
+   Uring(Params const& params, int flags, unsigned depth) noexcept
+      : PerThreadFd(params, flags)
+      , m_depth(depth)
+   {}
+
+   // the rings are set up here, outside the timed run
+   void initialize(unsigned threads) override
+   {
+      PerThreadFd::initialize(threads);
+
+      m_rings.clear();
+      for (unsigned i = 0; i < threads; ++i)
+      {
+         auto ring = std::make_unique<Ring>();
+         if (!ring->setup(m_depth))
+            ring.reset();
+
+         m_rings.push_back(std::move(ring));
+      }
+   }
+
+   void finalize() override
+   {
+      m_rings.clear();
+
+      PerThreadFd::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      if (!m_rings[tid])
+         return 0;
+
+      auto& ring = *m_rings[tid];
+
+      Benchmark::TimestampProvider clock;
+      auto cursor = start(tid);
+      auto buf = m_buffers[tid].get();
+      auto fd = m_fds[tid];
+      auto& latencies = m_latencies[tid];
+      std::vector<std::uint64_t> submitted(m_depth);
+
+      auto submit = [&](unsigned slot)
+      {
+         submitted[slot] = clock().count();
+         ring.read(fd, buf + slot * m_params.block, m_params.block, next(cursor), slot);
+      };
+
+      auto toSubmit = iterations;
+      unsigned inFlight = 0;
+      for (unsigned slot = 0; slot < m_depth && toSubmit; ++slot, --toSubmit, ++inFlight)
+         submit(slot);
+
+      std::uint64_t bytes = 0;
+      std::vector<unsigned> freed;
+      freed.reserve(m_depth);
+      while (inFlight)
+      {
+         if (!ring.enter(1))
+            break;
+
+         auto now = std::uint64_t(clock().count());
+         freed.clear();
+         inFlight -= ring.reap(
+            [&](io_uring_cqe const& cqe)
+            {
+               auto slot = unsigned(cqe.user_data);
+               latencies.record(now - submitted[slot]);
+               if (cqe.res > 0)
+                  bytes += std::uint64_t(cqe.res);
+
+               freed.push_back(slot);
+            }
+         );
+
+         for (auto slot: freed)
+         {
+            if (!toSubmit)
+               break;
+
+            submit(slot);
+            --toSubmit;
+            ++inFlight;
+         }
+      }
+
+      done(bytes);
+      return 0;
+   }
+
+protected:
+   unsigned depth() const noexcept override
+   {
+      return m_depth;
+   }
+
+private:
+   unsigned const m_depth;
+   std::vector<std::unique_ptr<Ring>> m_rings;
+};
+
+
+bool directSupported(TempFile const& file)
+{
+   auto fd = ::open(file.path(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+   if (fd < 0)
+      return false;
+
+   ::close(fd);
+   return true;
+}
+
+
+std::string blockName(std::size_t block)
+{
+   if (block >= 1024 * 1024)
+      return std::to_string(block / (1024 * 1024)) + " MB";
+
+   return std::to_string(block / 1024) + " KB";
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+
+   std::uint64_t sizeMb = 64;
+   Benchmark::bindArg(
+      cmd,
+      "-s",
+      sizeMb,
+      "-s must be a file size in MB"
+   );
+
+   std::filesystem::path dir = std::filesystem::temp_directory_path();
+   std::string_view dirArg;
+   if (cmd.get("-d", dirArg) == Benchmark::CmdLine::ArgType::Ok)
+      dir = dirArg;
+
+   bool const warm = cmd.contains("-w");
+
+   TempFile file(dir, std::max<std::uint64_t>(sizeMb, 1) * 1024 * 1024);
+   if (!file.valid())
+   {
+      std::cerr << "failed to create a temporary file in " << dir << "\n";
+      return EXIT_FAILURE;
+   }
+
+   bool const direct = directSupported(file);
+   bool const uring = Ring::supported();
+   auto const uringFlags = direct ? O_DIRECT : 0;
+
+   for (auto pattern: { Pattern::Sequential, Pattern::Random })
+   {
+      for (std::size_t block: { 4096u, 65536u, 1048576u })
+      {
+         Params params{ &file, block, pattern, warm };
+         bool const sequential = (pattern == Pattern::Sequential);
+
+         Benchmark::Runner r(
+            std::string(sequential ? "Sequential" : "Random") +
+               " reads, " + blockName(block) + " blocks" +
+               (warm ? ", warm cache" : ", cold cache"),
+            file.size() / block
+         );
+
+         if (sequential)
+         {
+            r.add(
+               "read()",
+               Benchmark::Fixture::make<Read>(params, 0),
+               { 1, 2, 4 }
+            );
+         }
+
+         r.add(
+            "pread()",
+            Benchmark::Fixture::make<Pread>(params, 0),
+            { 1, 2, 4 }
+         );
+
+         r.add(
+            "mmap()",
+            Benchmark::Fixture::make<Mmap>(params, MADV_NORMAL, false),
+            { 1, 2, 4 }
+         );
+
+         r.add(
+            sequential ? "mmap() + MADV_SEQUENTIAL" : "mmap() + MADV_RANDOM",
+            Benchmark::Fixture::make<Mmap>(
+               params,
+               sequential ? MADV_SEQUENTIAL : MADV_RANDOM,
+               false
+            ),
+            { 1, 2, 4 }
+         );
+
+         r.add(
+            "mmap() + MAP_POPULATE",
+            Benchmark::Fixture::make<Mmap>(params, MADV_NORMAL, true),
+            { 1, 2, 4 }
+         );
+
+         if (direct)
+         {
+            r.add(
+               "pread() + O_DIRECT",
+               Benchmark::Fixture::make<Pread>(params, O_DIRECT),
+               { 1, 2, 4 }
+            );
+         }
+
+         if (uring)
+         {
+            for (unsigned depth: { 1u, 4u, 16u, 64u })
+            {
+               r.add(
+                  std::string("io_uring") + (direct ? " + O_DIRECT" : "") +
+                     ", queue depth " + std::to_string(depth),
+                  Benchmark::Fixture::make<Uring>(params, uringFlags, depth),
+                  { 1, 2, 4 }
+               );
+            }
+         }
+
+         r.run();
+      }
+   }
+
+   if (!direct)
+      std::cout << "O_DIRECT is not supported in " << dir << ", skipped\n";
+
+   if (!uring)
+      std::cout << "io_uring is not available, skipped\n";
+
+   return 0;
+}
@@ -0,0 +1,478 @@
+//
+// TLB reach: random (dependent) and sequential reads over buffers backed
+// by 4 KiB pages, transparent huge pages and explicit MAP_HUGETLB 2 MiB
+// and 1 GiB pages, as the buffer grows past what the TLBs cover
+//
+//    hugepages [-n <accesses per row>] [-m <max MiB>]
+//
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/perf.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/stopwatch.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+#if BM_POSIX
+   #include <sys/mman.h>
+#endif
+
+
+namespace
+{
+
+
+constexpr std::size_t kLine = 64;
+constexpr std::size_t k2M = std::size_t{1} << 21;
+constexpr std::size_t k1G = std::size_t{1} << 30;
+
+
+enum class Backing
+{
+   Pages4K,
+   Transparent,
+   HugeTlb2M,
+   HugeTlb1G
+};
+
+char const* backingName(Backing b) noexcept
+{
+   switch (b)
+   {
+   case Backing::Pages4K: return "4 KiB pages";
+   case Backing::Transparent: return "THP, madvise(MADV_HUGEPAGE)";
+   case Backing::HugeTlb2M: return "MAP_HUGETLB, 2 MiB";
+   default: return "MAP_HUGETLB, 1 GiB";
+   }
+}
+
+
+// an anonymous mapping, prefaulted; empty if the backing is unavailable
+class Mapping final
+{
+public:
+   Mapping() noexcept = default;
+
+   Mapping(Backing backing, std::size_t size) noexcept
+   {
+      auto req = request(backing, size);
+      auto p = ::mmap(nullptr, req.size + req.align, PROT_READ | PROT_WRITE, req.flags, -1, 0);
+      if (p == MAP_FAILED)
+         return;
+
+      m_base = static_cast<char*>(p);
+      m_mapped = req.size + req.align;
+      m_data = m_base;
+      if (req.align)
+         m_data = reinterpret_cast<char*>(roundUp(std::uintptr_t(m_base), req.align));
+
+      m_size = req.size;
+
+      if (backing == Backing::Pages4K)
+         ::madvise(m_data, m_size, MADV_NOHUGEPAGE);
+      else if (backing == Backing::Transparent)
+         ::madvise(m_data, m_size, MADV_HUGEPAGE);
+
+      std::memset(m_data, 0, m_size);
+   }
+
+   // whether the backing can supply size bytes; maps and unmaps without
+   // touching the pages, since huge page pools are reserved at mmap()
+   static bool available(Backing backing, std::size_t size) noexcept
+   {
+      auto req = request(backing, size);
+      auto p = ::mmap(nullptr, req.size + req.align, PROT_READ | PROT_WRITE, req.flags, -1, 0);
+      if (p == MAP_FAILED)
+         return false;
+
+      ::munmap(p, req.size + req.align);
+      return true;
+   }
+
+   Mapping(Mapping&& o) noexcept
+      : m_base(std::exchange(o.m_base, nullptr))
+      , m_data(std::exchange(o.m_data, nullptr))
+      , m_mapped(std::exchange(o.m_mapped, 0))
+      , m_size(std::exchange(o.m_size, 0))
+   {}
+
+   Mapping& operator=(Mapping&& o) noexcept
+   {
+      std::swap(m_base, o.m_base);
+      std::swap(m_data, o.m_data);
+      std::swap(m_mapped, o.m_mapped);
+      std::swap(m_size, o.m_size);
+      return *this;
+   }
+
+   ~Mapping()
+   {
+      if (m_base)
+         ::munmap(m_base, m_mapped);
+   }
+
+   explicit operator bool() const noexcept
+   {
+      return m_data != nullptr;
+   }
+
+   char* data() const noexcept
+   {
+      return m_data;
+   }
+
+   std::size_t size() const noexcept
+   {
+      return m_size;
+   }
+
+   // the share of the buffer the kernel actually backs with huge
+   // pages, from /proc/self/smaps; -1 if that cannot be read
+   double hugePercent() const
+   {
+      std::ifstream smaps("/proc/self/smaps");
+      if (!smaps)
+         return -1;
+
+      auto begin = std::uintptr_t(m_data);
+      auto end = begin + m_size;
+
+      std::uint64_t huge = 0;
+      bool inside = false;
+      std::uint64_t pageKb = 4;
+      std::uint64_t sizeKb = 0;
+      std::uint64_t totalKb = 0;
+
+      std::string line;
+      while (std::getline(smaps, line))
+      {
+         std::uintptr_t from = 0, to = 0;
+         char dash = 0;
+         std::istringstream s(line);
+         s >> std::hex >> from >> dash >> to;
+         if (s && dash == '-')
+         {
+            // a new mapping header
+            inside = from < end && to > begin;
+            continue;
+         }
+
+         if (!inside)
+            continue;
+
+         std::string key;
+         std::uint64_t kb = 0;
+         std::istringstream f(line);
+         f >> key >> kb;
+         if (key == "Size:")
+         {
+            sizeKb = kb;
+            totalKb += kb;
+         }
+         else if (key == "KernelPageSize:")
+         {
+            pageKb = kb;
+            if (pageKb > 4)
+               huge += sizeKb;
+         }
+         else if (key == "AnonHugePages:" && pageKb <= 4)
+         {
+            huge += kb;
+         }
+      }
+
+      return totalKb ? 100.0 * double(huge) / double(totalKb) : 0.0;
+   }
+
+private:
+   static std::size_t roundUp(std::size_t v, std::size_t to) noexcept
+   {
+      return (v + to - 1) / to * to;
+   }
+
+   struct Request
+   {
+      int flags;
+      std::size_t size;    // rounded up to the page size
+      std::size_t align;   // extra bytes mapped to align the data
+   };
+
+   static Request request(Backing backing, std::size_t size) noexcept
+   {
+      Request req = { MAP_PRIVATE | MAP_ANONYMOUS, size, 0 };
+
+      switch (backing)
+      {
+      case Backing::Pages4K:
+         break;
+
+      case Backing::Transparent:
+         // whole, aligned 2 MiB ranges are what khugepaged and the
+         // fault path can back with huge pages
+         req.align = k2M;
+         break;
+
+      case Backing::HugeTlb2M:
+         req.flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+         req.size = roundUp(size, k2M);
+         break;
+
+      case Backing::HugeTlb1G:
+         req.flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+         req.size = roundUp(size, k1G);
+         break;
+      }
+
+      return req;
+   }
+
+   char* m_base = nullptr;
+   char* m_data = nullptr;
+   std::size_t m_mapped = 0;
+   std::size_t m_size = 0;
+};
+
+
+enum class Access
+{
+   Random,
+   Sequential
+};
+
+
+// an iteration is one access to a 64-byte line: in the random rows the
+// next line is read from the current one, a single cycle through all
+// lines in random order, so every access waits for its page walk
+class Walk final
+   : public Benchmark::Fixture
+{
+public:
+   Walk(Backing backing, Access access, std::size_t size) noexcept
+      : m_backing(backing)
+      , m_access(access)
+      , m_size(size)
+   {}
+
+   void initialize(unsigned) override
+   {
+      m_mapping = Mapping(m_backing, m_size);
+      m_accesses = 0;
+      m_ns = 0;
+      m_misses = 0;
+      m_position = 0;
+      m_hugePercent = -1;
+
+      // the pool may have run dry since main() probed it
+      if (!m_mapping)
+         return;
+
+      m_hugePercent = m_mapping.hugePercent();
+
+      auto lines = m_size / kLine;
+      auto line = [this](std::size_t i)
+      {
+         return reinterpret_cast<std::uint64_t*>(m_mapping.data() + i * kLine);
+      };
+
+      if (m_access == Access::Random)
+      {
+         // Sattolo's shuffle: a permutation that is one cycle
+         std::vector<std::uint32_t> order(lines);
+         std::iota(order.begin(), order.end(), 0u);
+
+         Benchmark::Random r(lines);
+         for (auto i = lines - 1; i > 0; --i)
+            std::swap(order[i], order[r(i - 1)]);
+
+         for (std::size_t i = 0; i < lines; ++i)
+            *line(i) = order[i];
+      }
+      else
+      {
+         for (std::size_t i = 0; i < lines; ++i)
+            *line(i) = (i + 1) % lines;
+      }
+   }
+
+   void finalize() override
+   {
+      m_mapping = {};
+   }
+
+   void prologue(Benchmark::Tid) override
+   {
+      m_dtlb = Benchmark::PerfCounter(Benchmark::PerfCounter::Event::DtlbLoadMisses);
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      if (!m_mapping)
+         return 0;
+
+      auto base = m_mapping.data();
+      auto lines = m_size / kLine;
+      auto position = m_position;
+
+      Benchmark::Stopwatch<Benchmark::TimestampProvider> sw;
+      m_dtlb.start();
+      sw.start();
+
+      std::uint64_t sum = 0;
+      if (m_access == Access::Random)
+      {
+         for (auto i = iterations; i; --i)
+            position = *reinterpret_cast<std::uint64_t const*>(base + position * kLine);
+
+         sum = position;
+      }
+      else
+      {
+         for (auto i = iterations; i; --i)
+         {
+            sum += *reinterpret_cast<std::uint64_t const*>(base + position * kLine);
+            if (++position == lines)
+               position = 0;
+         }
+      }
+
+      m_ns += std::uint64_t(sw.stop().count());
+      m_misses += m_dtlb.stop();
+      m_accesses += iterations;
+      m_position = position;
+      g_dontOptimize = sum;
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      auto accesses = double(m_accesses ? m_accesses : 1);
+      m.push_back({ "ns/access", double(m_ns) / accesses });
+
+      if (m_dtlb.valid())
+         m.push_back({ "dTLB misses/access", double(m_misses) / accesses });
+
+      if (m_hugePercent >= 0)
+         m.push_back({ "% huge pages", m_hugePercent });
+   }
+
+private:
+   static inline volatile std::uint64_t g_dontOptimize = 0;
+
+   Backing const m_backing;
+   Access const m_access;
+   std::size_t const m_size;
+   Mapping m_mapping;
+   Benchmark::PerfCounter m_dtlb;
+   std::uint64_t m_position = 0;
+   std::uint64_t m_accesses = 0;
+   std::uint64_t m_ns = 0;
+   std::uint64_t m_misses = 0;
+   double m_hugePercent = -1;
+};
+
+
+std::string sizeName(std::size_t n)
+{
+   if (n >= k1G)
+      return std::to_string(n >> 30) + " GiB";
+
+   if (n >= (std::size_t{1} << 20))
+      return std::to_string(n >> 20) + " MiB";
+
+   return std::to_string(n >> 10) + " KiB";
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+
+   std::uint64_t accesses = 20000000ULL;
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      accesses,
+      "-n must be a positive integer"
+   );
+
+   std::uint64_t maxMiB = 1024;
+   Benchmark::bindArg(
+      cmd,
+      "-m",
+      maxMiB,
+      "-m must be a positive integer"
+   );
+
+   // explicit huge pages come from a pool the administrator reserves
+   // (vm.nr_hugepages, or hugepages-1048576kB/nr_hugepages for 1 GiB)
+   std::vector<Backing> backings;
+   for (auto b: { Backing::Pages4K, Backing::Transparent, Backing::HugeTlb2M, Backing::HugeTlb1G })
+   {
+      if (Mapping::available(b, 4096))
+         backings.push_back(b);
+      else
+         std::cout << backingName(b) << " are not available, skipped\n";
+   }
+
+   if (!Benchmark::PerfCounter(Benchmark::PerfCounter::Event::DtlbLoadMisses).valid())
+      std::cout << "perf_event_open is not available, no dTLB miss counts\n";
+
+   // from the L1 dTLB's 4 KiB reach (64 entries) to well past the L2
+   // TLB's 2 MiB reach, ending at -m itself: a 1 GiB page only pays off
+   // for a working set that large
+   auto const maxSize = std::size_t{maxMiB} << 20;
+   std::vector<std::size_t> sizes;
+   for (std::size_t s = std::size_t{256} << 10; s <= maxSize; s *= 4)
+      sizes.push_back(s);
+
+   if (sizes.empty() || sizes.back() != maxSize)
+      sizes.push_back(maxSize);
+
+   for (auto access: { Access::Random, Access::Sequential })
+   {
+      for (auto size: sizes)
+      {
+         Benchmark::Runner r(
+            std::string(access == Access::Random ? "Random" : "Sequential") +
+               " reads, " + sizeName(size),
+            accesses
+         );
+
+         for (auto b: backings)
+         {
+            // the pool may hold small buffers but not this one
+            if (b == Backing::HugeTlb2M || b == Backing::HugeTlb1G)
+            {
+               if (!Mapping::available(b, size))
+               {
+                  std::cout << backingName(b) << ": no " << sizeName(size) << " in the pool, skipped\n";
+                  continue;
+               }
+            }
+
+            r.add(backingName(b), Benchmark::Fixture::make<Walk>(b, access, size));
+         }
+
+         r.run();
+      }
+   }
+
+   return 0;
+}
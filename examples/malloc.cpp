@@ -1,6 +1,12 @@
+#include <atomic>
+#include <bit>
 #include <cstdlib>
+#include <memory_resource>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include "benchmark/alloctrace.hpp"
 #include "benchmark/runner.hpp"
 #include "benchmark/util.hpp"
 
@@ -9,6 +15,282 @@ namespace
 {
 
 
+struct Block
+{
+   void* p = nullptr;
+   std::size_t size = 0;
+};
+
+
+// plain malloc()/free()
+class MallocAllocator final
+{
+public:
+   void initialize(unsigned) {}
+   void finalize() {}
+
+   void* allocate(Benchmark::Tid, std::size_t size) noexcept
+   {
+      return std::malloc(size);
+   }
+
+   void deallocate(Benchmark::Tid, Block const& b) noexcept
+   {
+      std::free(b.p);
+   }
+
+   void release(Benchmark::Tid) noexcept {}
+};
+
+
+// one std::pmr resource per thread
+template <class Resource>
+class PerThreadPmrAllocator final
+{
+public:
+   void initialize(unsigned threads)
+   {
+      for (unsigned i = 0; i < threads; ++i)
+         m_res.emplace_back(new Resource);
+   }
+
+   void finalize()
+   {
+      m_res.clear();
+   }
+
+   void* allocate(Benchmark::Tid tid, std::size_t size)
+   {
+      return m_res[tid]->allocate(size);
+   }
+
+   void deallocate(Benchmark::Tid tid, Block const& b)
+   {
+      m_res[tid]->deallocate(b.p, b.size);
+   }
+
+   // rewinds a monotonic arena, which is its point; a pool keeps its
+   // chunks, so that it reaches a steady state across runs rather than
+   // handing everything back upstream inside the timing
+   void release(Benchmark::Tid tid)
+   {
+      if constexpr (std::is_same_v<Resource, std::pmr::monotonic_buffer_resource>)
+         m_res[tid]->release();
+   }
+
+private:
+   std::vector<std::unique_ptr<Resource>> m_res;
+};
+
+
+using MonotonicAllocator =
+   PerThreadPmrAllocator<std::pmr::monotonic_buffer_resource>;
+
+using UnsyncPoolAllocator =
+   PerThreadPmrAllocator<std::pmr::unsynchronized_pool_resource>;
+
+
+// one std::pmr::synchronized_pool_resource shared by all threads
+class SyncPoolAllocator final
+{
+public:
+   void initialize(unsigned)
+   {
+      m_res.reset(new std::pmr::synchronized_pool_resource);
+   }
+
+   void finalize()
+   {
+      m_res.reset();
+   }
+
+   void* allocate(Benchmark::Tid, std::size_t size)
+   {
+      return m_res->allocate(size);
+   }
+
+   void deallocate(Benchmark::Tid, Block const& b)
+   {
+      m_res->deallocate(b.p, b.size);
+   }
+
+   void release(Benchmark::Tid) noexcept {}
+
+private:
+   std::unique_ptr<std::pmr::synchronized_pool_resource> m_res;
+};
+
+
+// per-thread power-of-two size classes carved from 64K slabs;
+// blocks must be freed by the thread that allocated them
+class SlabAllocator final
+{
+public:
+   void initialize(unsigned threads)
+   {
+      for (unsigned i = 0; i < threads; ++i)
+         m_heaps.emplace_back(new Heap);
+   }
+
+   void finalize()
+   {
+      m_heaps.clear();
+   }
+
+   void* allocate(Benchmark::Tid tid, std::size_t size) noexcept
+   {
+      if (size > kMaxSize)
+         return std::malloc(size);
+
+      auto& c = m_heaps[tid]->classes[sizeClass(size)];
+      if (c.free)
+      {
+         auto n = c.free;
+         c.free = n->next;
+         return n;
+      }
+
+      auto const blockSize = kMinSize << sizeClass(size);
+      if (c.cur == c.end)
+      {
+         c.cur = static_cast<char*>(std::malloc(kSlabSize));
+         c.end = c.cur + kSlabSize;
+         m_heaps[tid]->slabs.push_back(c.cur);
+      }
+
+      auto p = c.cur;
+      c.cur += blockSize;
+      return p;
+   }
+
+   void deallocate(Benchmark::Tid tid, Block const& b) noexcept
+   {
+      if (b.size > kMaxSize)
+         return std::free(b.p);
+
+      auto& c = m_heaps[tid]->classes[sizeClass(b.size)];
+      auto n = static_cast<FreeNode*>(b.p);
+      n->next = c.free;
+      c.free = n;
+   }
+
+   void release(Benchmark::Tid) noexcept {}
+
+private:
+   static constexpr std::size_t kMinShift = 4;
+   static constexpr std::size_t kMinSize = std::size_t{1} << kMinShift;
+   static constexpr std::size_t kClasses = 7;
+   static constexpr std::size_t kMaxSize = kMinSize << (kClasses - 1);
+   static constexpr std::size_t kSlabSize = 64 * 1024;
+
+   static std::size_t sizeClass(std::size_t size) noexcept
+   {
+      if (size <= kMinSize)
+         return 0;
+
+      return std::bit_width(size - 1) - kMinShift;
+   }
+
+   struct FreeNode
+   {
+      FreeNode* next;
+   };
+
+   struct SizeClass
+   {
+      FreeNode* free = nullptr;
+      char* cur = nullptr;
+      char* end = nullptr;
+   };
+
+   struct Heap
+   {
+      ~Heap()
+      {
+         for (auto s: slabs)
+            std::free(s);
+      }
+
+      SizeClass classes[kClasses];
+      std::vector<char*> slabs;
+   };
+
+   std::vector<std::unique_ptr<Heap>> m_heaps;
+};
+
+
+// per-thread bump pointer over reusable 1M chunks (so no block may
+// exceed 1M); individual frees are no-ops, release() rewinds the arena
+class BumpArena final
+{
+public:
+   void initialize(unsigned threads)
+   {
+      for (unsigned i = 0; i < threads; ++i)
+         m_arenas.emplace_back(new Arena);
+   }
+
+   void finalize()
+   {
+      m_arenas.clear();
+   }
+
+   void* allocate(Benchmark::Tid tid, std::size_t size) noexcept
+   {
+      auto a = m_arenas[tid].get();
+      size = (size + kAlign - 1) & ~(kAlign - 1);
+
+      if (a->cur + size > a->end)
+      {
+         if (++a->next > a->chunks.size())
+         {
+            a->chunks.push_back(
+               static_cast<char*>(std::malloc(kChunkSize))
+            );
+         }
+
+         a->cur = a->chunks[a->next - 1];
+         a->end = a->cur + kChunkSize;
+      }
+
+      auto p = a->cur;
+      a->cur += size;
+      return p;
+   }
+
+   void deallocate(Benchmark::Tid, Block const&) noexcept {}
+
+   void release(Benchmark::Tid tid) noexcept
+   {
+      auto a = m_arenas[tid].get();
+      a->next = 0;
+      a->cur = nullptr;
+      a->end = nullptr;
+   }
+
+private:
+   static constexpr std::size_t kAlign = alignof(std::max_align_t);
+   static constexpr std::size_t kChunkSize = 1024 * 1024;
+
+   struct Arena
+   {
+      ~Arena()
+      {
+         for (auto c: chunks)
+            std::free(c);
+      }
+
+      std::vector<char*> chunks;
+      std::size_t next = 0;
+      char* cur = nullptr;
+      char* end = nullptr;
+   };
+
+   std::vector<std::unique_ptr<Arena>> m_arenas;
+};
+
+
+template <class Allocator>
 struct Fixture
    : public Benchmark::Fixture
 {
@@ -23,7 +305,9 @@ struct Fixture
 
    void initialize(unsigned threads) override
    {
-      m_td.reserve(kSizes.size());
+      m_alloc.initialize(threads);
+
+      m_td.reserve(threads);
       for (unsigned i = 0; i < threads; ++i)
       {
          m_td.emplace_back(
@@ -35,6 +319,7 @@ struct Fixture
    void finalize() override
    {
       m_td.clear();
+      m_alloc.finalize();
    }
 
 protected:
@@ -46,24 +331,50 @@ protected:
       }
 
       std::size_t nextSize = 0;
-      std::size_t nextAlloc = 0;
-      std::vector<void*> allocated;
+      std::vector<Block> allocated;
    };
 
+   Block allocate(ThreadData* td, Benchmark::Tid tid)
+   {
+      auto iSize = td->nextSize++;
+      if (td->nextSize == kSizes.size())
+         td->nextSize = 0;
+
+      auto size = kSizes[iSize];
+      return Block{ m_alloc.allocate(tid, size), size };
+   }
+
+   void deallocateAll(ThreadData* td, Benchmark::Tid tid)
+   {
+      for (auto& a: td->allocated)
+      {
+         if (a.p)
+            m_alloc.deallocate(tid, a);
+
+         a = {};
+      }
+
+      m_alloc.release(tid);
+   }
+
    std::vector<std::size_t> const kSizes;
    std::size_t const m_allocCount;
    std::vector<std::unique_ptr<ThreadData>> m_td;
+   Allocator m_alloc;
 };
 
 
-struct Malloc
-   : public Fixture
+template <class Allocator>
+struct Allocate
+   : public Fixture<Allocator>
 {
-   Malloc(
+   using Super = Fixture<Allocator>;
+
+   Allocate(
       std::size_t allocCount,
       std::initializer_list<std::size_t> sizes
    )
-      : Fixture(allocCount, sizes)
+      : Super(allocCount, sizes)
    {
    }
 
@@ -74,18 +385,13 @@ struct Malloc
    {
       std::size_t const n = std::min(
          std::size_t{iterations},
-         m_allocCount
+         this->m_allocCount
       );
 
-      auto td = m_td[tid].get();
+      auto td = this->m_td[tid].get();
       for (std::size_t i = 0; i < n; ++i)
       {
-         auto iSize = td->nextSize++;
-         if (td->nextSize == kSizes.size())
-            td->nextSize = 0;
-
-         auto nextSize = kSizes[iSize];
-         td->allocated[i] = std::malloc(nextSize);
+         td->allocated[i] = this->allocate(td, tid);
       }
 
       return iterations - n;
@@ -93,41 +399,97 @@ struct Malloc
 
    void epilogue(Benchmark::Tid tid) override
    {
-      auto td = m_td[tid].get();
-      for (auto& a: td->allocated)
-      {
-         std::free(a);
-         a = nullptr;
-      }
+      this->deallocateAll(this->m_td[tid].get(), tid);
    }
 
 };
 
 
-struct Free
-   : public Fixture
+// individual frees followed by the bulk release (if any)
+template <class Allocator>
+struct Deallocate
+   : public Fixture<Allocator>
 {
-   Free(
+   using Super = Fixture<Allocator>;
+
+   Deallocate(
       std::size_t allocCount,
       std::initializer_list<std::size_t> sizes
    )
-      : Fixture(allocCount, sizes)
+      : Super(allocCount, sizes)
    {
    }
 
    void prologue(Benchmark::Tid tid) override
    {
-      auto td = m_td[tid].get();
-      for (std::size_t i = 0; i < m_allocCount; ++i)
+      auto td = this->m_td[tid].get();
+      for (std::size_t i = 0; i < this->m_allocCount; ++i)
       {
-         auto iSize = td->nextSize++;
-         if (td->nextSize == kSizes.size())
-            td->nextSize = 0;
+         td->allocated[i] = this->allocate(td, tid);
+      }
+   }
 
-         auto nextSize = kSizes[iSize];
-         td->allocated[i] = std::malloc(nextSize);
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      std::size_t const n = std::min(
+         std::size_t{iterations},
+         this->m_allocCount
+      );
+
+      auto td = this->m_td[tid].get();
+      for (std::size_t i = 0; i < n; ++i)
+      {
+         this->m_alloc.deallocate(tid, td->allocated[i]);
+         td->allocated[i] = {};
       }
 
+      this->m_alloc.release(tid);
+
+      return iterations - n;
+   }
+
+   void epilogue(Benchmark::Tid tid) override
+   {
+      // whatever the last run() left behind
+      this->deallocateAll(this->m_td[tid].get(), tid);
+   }
+};
+
+
+// even threads allocate and hand the blocks over to their odd
+// neighbour through a SPSC ring, which frees them; with an odd
+// thread count the last thread allocates and frees on its own
+template <class Allocator>
+struct RemoteFree
+   : public Fixture<Allocator>
+{
+   using Super = Fixture<Allocator>;
+
+   RemoteFree(
+      std::size_t allocCount,
+      std::initializer_list<std::size_t> sizes
+   )
+      : Super(allocCount, sizes)
+   {
+   }
+
+   void initialize(unsigned threads) override
+   {
+      Super::initialize(threads);
+
+      m_threads = threads;
+      m_channels.clear();
+      for (unsigned i = 0; i < threads; i += 2)
+         m_channels.emplace_back(new Channel);
+   }
+
+   void finalize() override
+   {
+      m_channels.clear();
+      Super::finalize();
    }
 
    Benchmark::Counter run(
@@ -135,17 +497,180 @@ struct Free
       Benchmark::Tid tid
    ) override
    {
-      auto td = m_td[tid].get();
-      for (auto& a: td->allocated)
+      auto td = this->m_td[tid].get();
+      auto ch = m_channels[tid / 2].get();
+
+      if ((tid ^ 1) >= m_threads)
       {
-         std::free(a);
-         a = nullptr;
-         if (!--iterations)
-            break;
+         // no partner
+         auto n = std::min(std::size_t{iterations}, this->m_allocCount);
+         for (std::size_t i = 0; i < n; ++i)
+            td->allocated[i] = this->allocate(td, tid);
+
+         this->deallocateAll(td, tid);
+         return iterations - n;
       }
 
-      return iterations;
+      if ((tid & 1) == 0)
+      {
+         while (iterations--)
+            ch->push(this->allocate(td, tid));
+      }
+      else
+      {
+         while (iterations--)
+            this->m_alloc.deallocate(tid, ch->pop());
+      }
+
+      return 0;
    }
+
+private:
+   struct Channel
+   {
+      static constexpr std::size_t kCapacity = 1024;
+
+      void push(Block const& b) noexcept
+      {
+         auto t = tail.load(std::memory_order_relaxed);
+         while (t - head.load(std::memory_order_acquire) == kCapacity)
+            std::this_thread::yield();
+
+         ring[t % kCapacity] = b;
+         tail.store(t + 1, std::memory_order_release);
+      }
+
+      Block pop() noexcept
+      {
+         auto h = head.load(std::memory_order_relaxed);
+         while (tail.load(std::memory_order_acquire) == h)
+            std::this_thread::yield();
+
+         auto b = ring[h % kCapacity];
+         head.store(h + 1, std::memory_order_release);
+         return b;
+      }
+
+      alignas(64) std::atomic<std::size_t> head = 0;
+      alignas(64) std::atomic<std::size_t> tail = 0;
+      alignas(64) Block ring[kCapacity];
+   };
+
+   unsigned m_threads = 0;
+   std::vector<std::unique_ptr<Channel>> m_channels;
+};
+
+
+// replays a recorded trace: recorded thread T is driven by replay
+// thread T % threads, and each operation waits until the previous
+// one on its slot has completed, so cross-thread frees keep their order
+template <class Allocator>
+struct Replay
+   : public Benchmark::Fixture
+{
+   Replay(Benchmark::AllocTrace const& trace)
+      : m_trace(trace)
+   {
+   }
+
+   void initialize(unsigned threads) override
+   {
+      m_alloc.initialize(threads);
+
+      auto const slots = m_trace.header().slots;
+      m_slots.reset(new Slot[slots]);
+
+      // number each operation within its slot
+      std::vector<std::uint32_t> seq(slots, 0);
+      auto records = m_trace.records();
+      m_queues.assign(threads, {});
+      for (std::size_t i = 0; i < records.size(); ++i)
+      {
+         m_queues[records[i].thread % threads].push_back(
+            Step{ i, seq[records[i].slot]++ }
+         );
+      }
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter,
+      Benchmark::Tid tid
+   ) override
+   {
+      using Op = Benchmark::AllocTrace::Op;
+
+      auto records = m_trace.records();
+      for (auto& step: m_queues[tid])
+      {
+         auto& rec = records[step.record];
+         auto& slot = m_slots[rec.slot];
+
+         while (slot.done.load(std::memory_order_acquire) != step.seq)
+            std::this_thread::yield();
+
+         if (rec.op == Op::Alloc)
+         {
+            slot.block = Block{ m_alloc.allocate(tid, rec.size), rec.size };
+         }
+         else
+         {
+            m_alloc.deallocate(tid, slot.block);
+            slot.block = {};
+         }
+
+         slot.done.store(step.seq + 1, std::memory_order_release);
+      }
+
+      return 0;
+   }
+
+   // the runner's iterations are the trace's records, all threads
+   // together
+   bool splitsWork() const override
+   {
+      return true;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({
+         "records/s",
+         double(m_trace.header().records),
+         Benchmark::Metric::Kind::Rate
+      });
+   }
+
+   void finalize() override
+   {
+      // blocks the trace never freed
+      for (std::uint32_t i = 0; i < m_trace.header().slots; ++i)
+      {
+         if (m_slots[i].block.p)
+            m_alloc.deallocate(0, m_slots[i].block);
+      }
+
+      m_slots.reset();
+      m_queues.clear();
+      m_alloc.finalize();
+   }
+
+private:
+   struct Slot
+   {
+      std::atomic<std::uint32_t> done = 0;   // operations completed
+      Block block;
+   };
+
+   struct Step
+   {
+      std::size_t record;
+      std::uint32_t seq;
+   };
+
+   Benchmark::AllocTrace const& m_trace;
+   std::unique_ptr<Slot[]> m_slots;
+   std::vector<std::vector<Step>> m_queues;
+   Allocator m_alloc;
 };
 
 } // namespace
@@ -179,7 +704,7 @@ int main(int argc, char** argv)
 
    r.add(
       "malloc()",
-      Fixture::make<Malloc>(
+      Benchmark::Fixture::make<Allocate<MallocAllocator>>(
          allocations,
          pattern
       ),
@@ -188,14 +713,163 @@ int main(int argc, char** argv)
 
    r.add(
       "free()",
-      Fixture::make<Free>(
+      Benchmark::Fixture::make<Deallocate<MallocAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "monotonic_buffer_resource::allocate()",
+      Benchmark::Fixture::make<Allocate<MonotonicAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "monotonic_buffer_resource::release()",
+      Benchmark::Fixture::make<Deallocate<MonotonicAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "unsynchronized_pool_resource::allocate()",
+      Benchmark::Fixture::make<Allocate<UnsyncPoolAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "unsynchronized_pool_resource::deallocate()",
+      Benchmark::Fixture::make<Deallocate<UnsyncPoolAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "synchronized_pool_resource::allocate()",
+      Benchmark::Fixture::make<Allocate<SyncPoolAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "synchronized_pool_resource::deallocate()",
+      Benchmark::Fixture::make<Deallocate<SyncPoolAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "slab allocate",
+      Benchmark::Fixture::make<Allocate<SlabAllocator>>(
          allocations,
          pattern
       ),
       { 1, 2, 4, 8 }
    );
 
+   r.add(
+      "slab free",
+      Benchmark::Fixture::make<Deallocate<SlabAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "bump arena allocate",
+      Benchmark::Fixture::make<Allocate<BumpArena>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "bump arena reset",
+      Benchmark::Fixture::make<Deallocate<BumpArena>>(
+         allocations,
+         pattern
+      ),
+      { 1, 2, 4, 8 }
+   );
+
+   r.add(
+      "malloc() -> remote free()",
+      Benchmark::Fixture::make<RemoteFree<MallocAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 2, 4, 8 }
+   );
+
+   r.add(
+      "synchronized_pool_resource -> remote deallocate()",
+      Benchmark::Fixture::make<RemoteFree<SyncPoolAllocator>>(
+         allocations,
+         pattern
+      ),
+      { 2, 4, 8 }
+   );
+
    r.run();
 
+   std::string_view tracePath;
+   if (cmd.get("-t", tracePath) == Benchmark::CmdLine::ArgType::Ok)
+   {
+      Benchmark::AllocTrace trace;
+      if (!trace.open(std::string(tracePath).c_str()))
+      {
+         std::cerr << "-t must name a valid allocation trace\n";
+         return EXIT_FAILURE;
+      }
+
+      // a process that exited before its first flush
+      if (!trace.header().records)
+      {
+         std::cerr << "the allocation trace holds no records\n";
+         return EXIT_FAILURE;
+      }
+
+      Benchmark::Runner rt(
+         "allocation trace replay",
+         trace.header().records
+      );
+
+      rt.add(
+         "malloc() replay",
+         Benchmark::Fixture::make<Replay<MallocAllocator>>(
+            std::cref(trace)
+         ),
+         { 1, 2, 4, 8 }
+      );
+
+      rt.add(
+         "synchronized_pool_resource replay",
+         Benchmark::Fixture::make<Replay<SyncPoolAllocator>>(
+            std::cref(trace)
+         ),
+         { 1, 2, 4, 8 }
+      );
+
+      rt.run();
+   }
+
    return 0;
 }
@@ -0,0 +1,554 @@
+//
+// block copies and fills: glibc memcpy/memmove/memset, std::copy and
+// std::fill, rep movsb/stosb and AVX non-temporal stores, swept over
+// size, source/destination misalignment and overlap
+//
+//    memcpy [-n <MB per row>] [-m <max bytes>]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+#if defined(__x86_64__)
+   #define MEMCPY_X86 1
+   #include <cpuid.h>
+   #include <immintrin.h>
+#else
+   #define MEMCPY_X86 0
+#endif
+
+#define MEMCPY_AVX __attribute__((target("avx")))
+
+
+namespace
+{
+
+
+enum class Isa
+{
+   Any,
+   RepString,
+   Avx
+};
+
+bool supported(Isa isa) noexcept
+{
+   switch (isa)
+   {
+   case Isa::Any:
+      return true;
+
+#if MEMCPY_X86
+   case Isa::RepString:
+      return true;
+
+   case Isa::Avx:
+      return __builtin_cpu_supports("avx");
+#endif
+
+   default:
+      return false;
+   }
+}
+
+// enhanced rep movsb/stosb, and fast short rep movsb
+std::string repFeatures()
+{
+#if MEMCPY_X86
+   unsigned a = 0, b = 0, c = 0, d = 0;
+   if (__get_cpuid_count(7, 0, &a, &b, &c, &d))
+   {
+      std::string s;
+      if (b & (1u << 9))
+         s += "ERMS";
+
+      if (d & (1u << 4))
+         s += s.empty() ? "FSRM" : ", FSRM";
+
+      return s.empty() ? "no ERMS" : s;
+   }
+#endif
+
+   return "no ERMS";
+}
+
+
+//
+// copies: n bytes from src to dst
+//
+
+using CopyFn = void (*)(void* dst, void const* src, std::size_t n);
+
+void copyMemcpy(void* dst, void const* src, std::size_t n)
+{
+   std::memcpy(dst, src, n);
+}
+
+void copyMemmove(void* dst, void const* src, std::size_t n)
+{
+   std::memmove(dst, src, n);
+}
+
+void copyStd(void* dst, void const* src, std::size_t n)
+{
+   auto s = static_cast<unsigned char const*>(src);
+   std::copy(s, s + n, static_cast<unsigned char*>(dst));
+}
+
+// the overlap-safe direction for std algorithms
+void moveStd(void* dst, void const* src, std::size_t n)
+{
+   auto s = static_cast<unsigned char const*>(src);
+   auto d = static_cast<unsigned char*>(dst);
+   if (d <= s)
+      std::copy(s, s + n, d);
+   else
+      std::copy_backward(s, s + n, d + n);
+}
+
+#if MEMCPY_X86
+
+void copyRepMovsb(void* dst, void const* src, std::size_t n)
+{
+   asm volatile(
+      "rep movsb"
+      : "+D"(dst), "+S"(src), "+c"(n)
+      :
+      : "memory"
+   );
+}
+
+// stores that bypass the cache, so a large copy does not evict the
+// working set and skips the read-for-ownership of the destination
+MEMCPY_AVX void copyStream(void* dst, void const* src, std::size_t n)
+{
+   auto d = static_cast<char*>(dst);
+   auto s = static_cast<char const*>(src);
+
+   auto head = std::min(n, (32 - std::uintptr_t(d) % 32) % 32);
+   std::memcpy(d, s, head);
+   d += head;
+   s += head;
+   n -= head;
+
+   for (; n >= 128; n -= 128, d += 128, s += 128)
+   {
+      auto x0 = _mm256_loadu_si256((__m256i const*)(s));
+      auto x1 = _mm256_loadu_si256((__m256i const*)(s + 32));
+      auto x2 = _mm256_loadu_si256((__m256i const*)(s + 64));
+      auto x3 = _mm256_loadu_si256((__m256i const*)(s + 96));
+      _mm256_stream_si256((__m256i*)(d), x0);
+      _mm256_stream_si256((__m256i*)(d + 32), x1);
+      _mm256_stream_si256((__m256i*)(d + 64), x2);
+      _mm256_stream_si256((__m256i*)(d + 96), x3);
+   }
+
+   // streaming stores are weakly ordered
+   if (d != dst)
+      _mm_sfence();
+
+   std::memcpy(d, s, n);
+}
+
+#endif // MEMCPY_X86
+
+
+//
+// fills: n bytes at dst
+//
+
+using FillFn = void (*)(void* dst, std::size_t n);
+
+constexpr unsigned char kFillByte = 0x5A;
+
+void fillMemset(void* dst, std::size_t n)
+{
+   std::memset(dst, kFillByte, n);
+}
+
+void fillStd(void* dst, std::size_t n)
+{
+   std::fill_n(static_cast<unsigned char*>(dst), n, kFillByte);
+}
+
+#if MEMCPY_X86
+
+void fillRepStosb(void* dst, std::size_t n)
+{
+   asm volatile(
+      "rep stosb"
+      : "+D"(dst), "+c"(n)
+      : "a"(kFillByte)
+      : "memory"
+   );
+}
+
+MEMCPY_AVX void fillStream(void* dst, std::size_t n)
+{
+   auto d = static_cast<char*>(dst);
+
+   auto head = std::min(n, (32 - std::uintptr_t(d) % 32) % 32);
+   std::memset(d, kFillByte, head);
+   d += head;
+   n -= head;
+
+   auto x = _mm256_set1_epi8(char(kFillByte));
+   for (; n >= 128; n -= 128, d += 128)
+   {
+      _mm256_stream_si256((__m256i*)(d), x);
+      _mm256_stream_si256((__m256i*)(d + 32), x);
+      _mm256_stream_si256((__m256i*)(d + 64), x);
+      _mm256_stream_si256((__m256i*)(d + 96), x);
+   }
+
+   if (d != dst)
+      _mm_sfence();
+
+   std::memset(d, kFillByte, n);
+}
+
+#endif // MEMCPY_X86
+
+
+struct Method
+{
+   std::string name;
+   Isa isa;
+   CopyFn copy = nullptr;
+   FillFn fill = nullptr;
+};
+
+
+//
+// buffers
+//
+
+constexpr std::size_t kPage = 4096;
+
+struct AlignedDeleter
+{
+   void operator()(char* p) const noexcept
+   {
+      std::free(p);
+   }
+};
+
+using AlignedBuffer = std::unique_ptr<char, AlignedDeleter>;
+
+// page aligned and touched, so page faults stay out of the timings
+AlignedBuffer alignedBuffer(std::size_t size)
+{
+   size = (size + kPage - 1) / kPage * kPage;
+   AlignedBuffer b(static_cast<char*>(std::aligned_alloc(kPage, size)));
+   if (b)
+      std::memset(b.get(), 1, size);
+
+   return b;
+}
+
+
+// where a thread's source and destination go
+struct Layout
+{
+   std::size_t size;
+   std::size_t srcOffset = 0;   // bytes past a page boundary
+   std::size_t dstOffset = 0;
+   std::ptrdiff_t overlap = 0;  // dst - src within one buffer; 0 is two buffers
+};
+
+
+// an iteration is one call; every thread works on its own buffers
+class Block final
+   : public Benchmark::Fixture
+{
+public:
+   Block(Method const& method, Layout layout)
+      : m_method(method)
+      , m_layout(layout)
+   {}
+
+   // buffers are set up here rather than in prologue(), which the
+   // threaded runs include in their wall time
+   void initialize(unsigned threads) override
+   {
+      m_threads.clear();
+      m_threads.resize(threads);
+      m_bytes = 0;
+
+      auto const& l = m_layout;
+      for (auto& t: m_threads)
+      {
+         if (l.overlap)
+         {
+            auto distance = std::size_t(l.overlap < 0 ? -l.overlap : l.overlap);
+            t.src = alignedBuffer(l.size + distance);
+            t.srcAt = t.src.get() + (l.overlap < 0 ? distance : 0);
+            t.dstAt = t.src.get() + (l.overlap < 0 ? 0 : distance);
+         }
+         else
+         {
+            t.src = alignedBuffer(l.size + l.srcOffset);
+            t.dst = alignedBuffer(l.size + l.dstOffset);
+            t.srcAt = t.src.get() + l.srcOffset;
+            t.dstAt = t.dst.get() + l.dstOffset;
+         }
+      }
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      auto& t = m_threads[tid];
+      auto n = m_layout.size;
+
+      if (m_method.copy)
+      {
+         auto fn = m_method.copy;
+         for (auto i = iterations; i; --i)
+            fn(t.dstAt, t.srcAt, n);
+      }
+      else
+      {
+         auto fn = m_method.fill;
+         for (auto i = iterations; i; --i)
+            fn(t.dstAt, n);
+      }
+
+      m_bytes.fetch_add(iterations * n, std::memory_order_relaxed);
+      g_dontOptimize = t.dstAt[n / 2];
+      return 0;
+   }
+
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({ "GB/s", double(m_bytes.load()) / 1e9, Benchmark::Metric::Kind::Rate });
+   }
+
+   void finalize() override
+   {
+      m_threads.clear();
+      m_threads.shrink_to_fit();
+   }
+
+private:
+   struct alignas(64) Thread
+   {
+      AlignedBuffer src;
+      AlignedBuffer dst;
+      char const* srcAt = nullptr;
+      char* dstAt = nullptr;
+   };
+
+   static inline volatile char g_dontOptimize = 0;
+
+   Method const m_method;
+   Layout const m_layout;
+   std::vector<Thread> m_threads;
+   std::atomic<std::uint64_t> m_bytes = 0;
+};
+
+
+std::string sizeName(std::size_t n)
+{
+   if (n >= (1u << 30))
+      return std::to_string(n >> 30) + " GiB";
+
+   if (n >= (1u << 20))
+      return std::to_string(n >> 20) + " MiB";
+
+   if (n >= (1u << 10))
+      return std::to_string(n >> 10) + " KiB";
+
+   return std::to_string(n) + " B";
+}
+
+// rows of small blocks would otherwise take minutes
+std::uint64_t iterationsFor(std::uint64_t bytesPerRow, std::size_t size)
+{
+   constexpr std::uint64_t kMaxIterations = 1ULL << 24;
+   return std::clamp<std::uint64_t>(bytesPerRow / size, 1, kMaxIterations);
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+
+   std::uint64_t megabytes = 1024;
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      megabytes,
+      "-n must be a positive integer"
+   );
+
+   std::uint64_t maxSize = std::uint64_t{1} << 30;
+   Benchmark::bindArg(
+      cmd,
+      "-m",
+      maxSize,
+      "-m must be a positive integer"
+   );
+
+   auto const bytesPerRow = megabytes << 20;
+
+   std::vector<Method> const copies = {
+      { "memcpy", Isa::Any, copyMemcpy },
+      { "memmove", Isa::Any, copyMemmove },
+      { "std::copy", Isa::Any, copyStd },
+#if MEMCPY_X86
+      { "rep movsb (" + repFeatures() + ")", Isa::RepString, copyRepMovsb },
+      { "AVX non-temporal copy", Isa::Avx, copyStream },
+#endif
+   };
+
+   std::vector<Method> const fills = {
+      { "memset", Isa::Any, nullptr, fillMemset },
+      { "std::fill", Isa::Any, nullptr, fillStd },
+#if MEMCPY_X86
+      { "rep stosb (" + repFeatures() + ")", Isa::RepString, nullptr, fillRepStosb },
+      { "AVX non-temporal fill", Isa::Avx, nullptr, fillStream },
+#endif
+   };
+
+   // more threads only while all their buffers fit in 1 GiB
+   auto threadsFor = [](std::size_t size)
+   {
+      std::vector<unsigned> threads;
+      for (unsigned t: { 1u, 2u, 4u })
+      {
+         if (t == 1 || 2 * size * t <= (std::size_t{1} << 30))
+            threads.push_back(t);
+      }
+
+      return threads;
+   };
+
+   // size: 1 B to 1 GiB
+   for (std::size_t size = 1; size <= maxSize; size *= 8)
+   {
+      Benchmark::Runner r(
+         "Aligned, " + sizeName(size),
+         iterationsFor(bytesPerRow, size)
+      );
+
+      for (auto const* methods: { &copies, &fills })
+      {
+         for (auto const& m: *methods)
+         {
+            if (supported(m.isa))
+               r.add(m.name, Benchmark::Fixture::make<Block>(m, Layout{ size }), threadsFor(size));
+         }
+      }
+
+      r.run();
+   }
+
+   // misalignment: the same copy with the pointers moved off a page
+   // boundary; rep movsb in particular has slow paths for some of these
+   struct Offsets
+   {
+      std::size_t src;
+      std::size_t dst;
+   };
+
+   constexpr Offsets kOffsets[] = {
+      { 0, 0 },
+      { 1, 0 },
+      { 0, 1 },
+      { 7, 13 },
+      { 32, 0 },
+      { 0, 32 },
+      { 63, 63 },
+   };
+
+   for (std::size_t size: { std::size_t{4} << 10, std::size_t{1} << 20 })
+   {
+      if (size > maxSize)
+         continue;
+
+      for (auto const& m: copies)
+      {
+         if (!supported(m.isa))
+            continue;
+
+         Benchmark::Runner r(
+            m.name + ", " + sizeName(size) + ", misaligned",
+            iterationsFor(bytesPerRow, size)
+         );
+
+         for (auto o: kOffsets)
+         {
+            r.add(
+               "src +" + std::to_string(o.src) + ", dst +" + std::to_string(o.dst),
+               Benchmark::Fixture::make<Block>(m, Layout{ size, o.src, o.dst })
+            );
+         }
+
+         r.run();
+      }
+   }
+
+   // overlap: dst = src + d within one buffer; only memmove and the
+   // direction-aware std algorithms are defined for it, and rep movsb
+   // for d < 0, where copying forwards is correct
+   Method const moves[] = {
+      { "memmove", Isa::Any, copyMemmove },
+      { "std::copy / std::copy_backward", Isa::Any, moveStd },
+#if MEMCPY_X86
+      { "rep movsb, forwards", Isa::RepString, copyRepMovsb },
+#endif
+   };
+
+   constexpr std::ptrdiff_t kDistances[] = { -4096, -64, -8, -1, 1, 8, 64, 4096 };
+
+   for (std::size_t size: { std::size_t{4} << 10, std::size_t{1} << 20 })
+   {
+      if (size > maxSize)
+         continue;
+
+      for (auto const& m: moves)
+      {
+         if (!supported(m.isa))
+            continue;
+
+         Benchmark::Runner r(
+            m.name + ", " + sizeName(size) + ", overlapping",
+            iterationsFor(bytesPerRow, size)
+         );
+
+         for (auto d: kDistances)
+         {
+#if MEMCPY_X86
+            if (m.copy == copyRepMovsb && d > 0)
+               continue;
+#endif
+
+            r.add(
+               "dst = src " + std::string(d < 0 ? "- " : "+ ") + std::to_string(d < 0 ? -d : d),
+               Benchmark::Fixture::make<Block>(m, Layout{ size, 0, 0, d })
+            );
+         }
+
+         r.run();
+      }
+   }
+
+   return 0;
+}
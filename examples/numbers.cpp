@@ -0,0 +1,425 @@
+//
+// number formatting and parsing: std::to_chars / from_chars against
+// std::format, the C library and string streams, the latter also with
+// the digit-grouping locale Terminal uses
+//
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if __has_include(<format>)
+   #include <format>
+#endif
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/terminal.hpp"
+#include "benchmark/util.hpp"
+
+
+namespace
+{
+
+
+constexpr std::size_t kValues = 4096;
+constexpr std::size_t kBufferSize = 64;
+
+
+// digit counts spread evenly rather than mostly 19-20 digits
+template <class T>
+std::vector<T> const& values()
+{
+   static std::vector<T> const v = []()
+   {
+      Benchmark::Random r(1);
+      std::vector<T> v(kValues);
+      for (auto& x: v)
+      {
+         if constexpr (std::is_floating_point_v<T>)
+            x = std::ldexp(r.real(), int(r(80u)) - 40);
+         else
+            x = T(r() >> r(63u));
+      }
+
+      return v;
+   }();
+
+   return v;
+}
+
+// the values in the shortest form that round-trips
+template <class T>
+std::vector<std::string> const& texts()
+{
+   static std::vector<std::string> const t = []()
+   {
+      std::vector<std::string> t;
+      for (auto x: values<T>())
+      {
+         char buf[kBufferSize];
+         auto r = std::to_chars(buf, buf + sizeof(buf), x);
+         t.emplace_back(buf, r.ptr);
+      }
+
+      return t;
+   }();
+
+   return t;
+}
+
+
+//
+// formatters: write one value, return its length
+//
+
+struct ToChars
+{
+   template <class T>
+   std::size_t operator()(T v, char* buf)
+   {
+      return std::size_t(std::to_chars(buf, buf + kBufferSize, v).ptr - buf);
+   }
+};
+
+// the %.17g form snprintf and the streams are given for doubles: 17
+// significant digits, longer than the shortest form above
+struct ToCharsPrecision
+{
+   std::size_t operator()(double v, char* buf)
+   {
+      return std::size_t(
+         std::to_chars(buf, buf + kBufferSize, v, std::chars_format::general, 17).ptr - buf
+      );
+   }
+};
+
+#if __cpp_lib_format
+
+struct Format
+{
+   template <class T>
+   std::size_t operator()(T v, char*)
+   {
+      return std::format("{}", v).size();
+   }
+};
+
+struct FormatToN
+{
+   template <class T>
+   std::size_t operator()(T v, char* buf)
+   {
+      return std::size_t(std::format_to_n(buf, kBufferSize, "{}", v).size);
+   }
+};
+
+#endif // __cpp_lib_format
+
+struct Snprintf
+{
+   std::size_t operator()(std::uint64_t v, char* buf)
+   {
+      return std::size_t(std::snprintf(buf, kBufferSize, "%llu", static_cast<unsigned long long>(v)));
+   }
+
+   std::size_t operator()(double v, char* buf)
+   {
+      return std::size_t(std::snprintf(buf, kBufferSize, "%.17g", v));
+   }
+};
+
+// one stream, emptied for every value
+class OStream
+{
+public:
+   OStream(std::locale const* locale = nullptr)
+   {
+      if (locale)
+         m_stream.imbue(*locale);
+
+      m_stream.precision(17);
+   }
+
+   template <class T>
+   std::size_t operator()(T v, char*)
+   {
+      m_stream.str({});
+      m_stream << v;
+      return m_stream.view().size();
+   }
+
+private:
+   std::ostringstream m_stream;
+};
+
+// a new stream for every value, the way to_string-style helpers do it
+struct OStreamPerValue
+{
+   template <class T>
+   std::size_t operator()(T v, char*)
+   {
+      std::ostringstream s;
+      s.precision(17);
+      s << v;
+      return s.view().size();
+   }
+};
+
+
+//
+// parsers
+//
+
+struct FromChars
+{
+   template <class T>
+   T operator()(std::string const& s, T)
+   {
+      T v{};
+      std::from_chars(s.data(), s.data() + s.size(), v);
+      return v;
+   }
+};
+
+struct Strto
+{
+   std::uint64_t operator()(std::string const& s, std::uint64_t)
+   {
+      return std::strtoull(s.c_str(), nullptr, 10);
+   }
+
+   double operator()(std::string const& s, double)
+   {
+      return std::strtod(s.c_str(), nullptr);
+   }
+};
+
+class IStream
+{
+public:
+   IStream(std::locale const* locale = nullptr)
+   {
+      if (locale)
+         m_stream.imbue(*locale);
+   }
+
+   template <class T>
+   T operator()(std::string const& s, T)
+   {
+      T v{};
+      m_stream.str(s);
+      m_stream.clear();
+      m_stream >> v;
+      return v;
+   }
+
+private:
+   std::istringstream m_stream;
+};
+
+
+//
+// fixtures; an iteration is one value
+//
+
+class Fixture
+   : public Benchmark::Fixture
+{
+public:
+   void initialize(unsigned) override
+   {
+      m_bytes = 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({ "MB/s", double(m_bytes) / 1e6, Benchmark::Metric::Kind::Rate });
+   }
+
+protected:
+   static volatile std::uint64_t g_dontOptimize;
+
+   std::uint64_t m_bytes = 0;
+};
+
+volatile std::uint64_t Fixture::g_dontOptimize = 0;
+
+
+template <class T, class Method>
+class FormatValues final
+   : public Fixture
+{
+public:
+   FormatValues(Method method = {})
+      : m_method(std::move(method))
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto const& v = values<T>();
+      char buf[kBufferSize] = {};
+
+      std::uint64_t bytes = 0;
+      std::size_t i = 0;
+      while (iterations--)
+      {
+         bytes += m_method(v[i], buf);
+         i = (i + 1) % kValues;
+      }
+
+      m_bytes += bytes;
+      g_dontOptimize = bytes + std::uint64_t(buf[0]);
+      return 0;
+   }
+
+private:
+   Method m_method;
+};
+
+
+template <class T, class Method>
+class ParseValues final
+   : public Fixture
+{
+public:
+   ParseValues(Method method = {})
+      : m_method(std::move(method))
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto const& t = texts<T>();
+
+      std::uint64_t bytes = 0;
+      T sum = 0;
+      std::size_t i = 0;
+      while (iterations--)
+      {
+         sum += m_method(t[i], T{});
+         bytes += t[i].size();
+         i = (i + 1) % kValues;
+      }
+
+      m_bytes += bytes;
+      g_dontOptimize = std::uint64_t(sum);
+      return 0;
+   }
+
+private:
+   Method m_method;
+};
+
+
+// doubles come out in two forms: the shortest that round-trips from
+// to_chars and std::format, 17 significant digits from the rest; the
+// rows say which, and to_chars also runs at 17 digits to compare
+template <class T>
+void addFormatters(Benchmark::Runner& r, std::locale const& grouping)
+{
+   constexpr bool kReal = std::is_floating_point_v<T>;
+   std::string const shortest = kReal ? ", shortest" : "";
+   std::string const digits17 = kReal ? ", 17 digits" : "";
+
+   r.add("std::to_chars" + shortest, Benchmark::Fixture::make<FormatValues<T, ToChars>>());
+   if constexpr (kReal)
+   {
+      r.add(
+         "std::to_chars" + digits17,
+         Benchmark::Fixture::make<FormatValues<T, ToCharsPrecision>>()
+      );
+   }
+
+#if __cpp_lib_format
+   r.add("std::format" + shortest, Benchmark::Fixture::make<FormatValues<T, Format>>());
+   r.add(
+      "std::format_to_n into a buffer" + shortest,
+      Benchmark::Fixture::make<FormatValues<T, FormatToN>>()
+   );
+#endif
+   r.add("snprintf" + digits17, Benchmark::Fixture::make<FormatValues<T, Snprintf>>());
+   r.add("std::ostringstream" + digits17, Benchmark::Fixture::make<FormatValues<T, OStream>>());
+   r.add(
+      "std::ostringstream, grouping locale" + digits17,
+      Benchmark::Fixture::make<FormatValues<T, OStream>>(OStream(&grouping))
+   );
+   r.add(
+      "std::ostringstream per value" + digits17,
+      Benchmark::Fixture::make<FormatValues<T, OStreamPerValue>>()
+   );
+}
+
+template <class T>
+void addParsers(Benchmark::Runner& r, std::locale const& grouping)
+{
+   r.add("std::from_chars", Benchmark::Fixture::make<ParseValues<T, FromChars>>());
+   r.add(
+      std::is_floating_point_v<T> ? "strtod" : "strtoull",
+      Benchmark::Fixture::make<ParseValues<T, Strto>>()
+   );
+   r.add("std::istringstream", Benchmark::Fixture::make<ParseValues<T, IStream>>());
+   r.add(
+      "std::istringstream, grouping locale",
+      Benchmark::Fixture::make<ParseValues<T, IStream>>(IStream(&grouping))
+   );
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t iterations = 1000000ULL;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   Benchmark::Terminal terminal;
+   auto const& grouping = terminal.locale();
+
+   {
+      Benchmark::Runner r("Format uint64", iterations);
+      addFormatters<std::uint64_t>(r, grouping);
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Format double", iterations);
+      addFormatters<double>(r, grouping);
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Parse uint64", iterations);
+      addParsers<std::uint64_t>(r, grouping);
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Parse double", iterations);
+      addParsers<double>(r, grouping);
+      r.run();
+   }
+
+   return 0;
+}
@@ -0,0 +1,554 @@
+//
+// parallel algorithms: std::sort, std::reduce and std::transform run
+// serially, with the std::execution policies (when the library has a
+// parallel backend) and split by hand over a small persistent pool.
+// Op and CPU columns only count the calling thread; "% serial speed"
+// compares wall times, 200 meaning twice as fast as serial
+//
+//    parallel [-n <elements per row>] [-m <max elements>] [-t <max split threads>]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __has_include(<execution>)
+   #include <execution>
+#endif
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/stopwatch.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+// libstdc++ only runs the policies in parallel with TBB linked in
+#if __cpp_lib_parallel_algorithm && !defined(_PSTL_PAR_BACKEND_SERIAL) && \
+   (!defined(__GLIBCXX__) || PARALLEL_HAS_TBB)
+   #define PARALLEL_POLICIES 1
+#else
+   #define PARALLEL_POLICIES 0
+#endif
+
+
+namespace
+{
+
+
+using Value = std::uint64_t;
+
+
+// runs job(i) for every i < size() on its threads, the caller being i = 0
+class SplitPool final
+{
+public:
+   explicit SplitPool(unsigned threads)
+      : m_size(std::max(threads, 1u))
+   {
+      for (unsigned i = 1; i < m_size; ++i)
+         m_threads.emplace_back([this, i]() { work(i); });
+   }
+
+   ~SplitPool()
+   {
+      {
+         std::lock_guard l(m_mutex);
+         m_stop = true;
+      }
+
+      m_start.notify_all();
+   }
+
+   unsigned size() const noexcept
+   {
+      return m_size;
+   }
+
+   // [first, last) of part i of n equal parts
+   static std::pair<std::size_t, std::size_t> part(
+      std::size_t n,
+      unsigned parts,
+      unsigned i
+   ) noexcept
+   {
+      return { n * i / parts, n * (i + 1) / parts };
+   }
+
+   void run(std::function<void(unsigned)> const& job)
+   {
+      {
+         std::lock_guard l(m_mutex);
+         m_job = &job;
+         m_pending = m_size - 1;
+         ++m_generation;
+      }
+
+      m_start.notify_all();
+      job(0);
+
+      std::unique_lock l(m_mutex);
+      m_done.wait(l, [this]() { return m_pending == 0; });
+   }
+
+private:
+   void work(unsigned i)
+   {
+      std::uint64_t seen = 0;
+      for (;;)
+      {
+         std::function<void(unsigned)> const* job;
+         {
+            std::unique_lock l(m_mutex);
+            m_start.wait(l, [&]() { return m_stop || m_generation != seen; });
+            if (m_stop)
+               return;
+
+            seen = m_generation;
+            job = m_job;
+         }
+
+         (*job)(i);
+
+         std::lock_guard l(m_mutex);
+         if (--m_pending == 0)
+            m_done.notify_one();
+      }
+   }
+
+   unsigned const m_size;
+   std::mutex m_mutex;
+   std::condition_variable m_start;
+   std::condition_variable m_done;
+   std::function<void(unsigned)> const* m_job = nullptr;
+   std::uint64_t m_generation = 0;
+   unsigned m_pending = 0;
+   bool m_stop = false;
+   std::vector<std::jthread> m_threads;
+};
+
+
+enum class Mode
+{
+   Serial,
+   Par,
+   ParUnseq,
+   Split
+};
+
+
+#if PARALLEL_POLICIES
+
+// calls f with the execution policy for mode
+template <class F>
+decltype(auto) withPolicy(Mode mode, F&& f)
+{
+   if (mode == Mode::ParUnseq)
+      return f(std::execution::par_unseq);
+
+   return f(std::execution::par);
+}
+
+#endif
+
+
+//
+// the algorithms; prepare() restores the input before every call and
+// is timed along with it
+//
+
+struct Sort
+{
+   static constexpr char const* kName = "std::sort of uint32";
+
+   Sort(std::size_t n)
+      : input(n)
+      , data(n)
+   {
+      Benchmark::Random r(1);
+      for (auto& x: input)
+         x = std::uint32_t(r());
+   }
+
+   void prepare()
+   {
+      std::copy(input.begin(), input.end(), data.begin());
+   }
+
+   Value run(Mode mode, SplitPool* pool)
+   {
+      auto b = data.begin();
+      auto e = data.end();
+
+      switch (mode)
+      {
+      case Mode::Serial:
+         std::sort(b, e);
+         break;
+
+      case Mode::Split:
+         {
+            // sort the parts, then merge neighbours in rounds
+            auto n = data.size();
+            auto parts = pool->size();
+            pool->run(
+               [&](unsigned i)
+               {
+                  auto [lo, hi] = SplitPool::part(n, parts, i);
+                  std::sort(b + lo, b + hi);
+               }
+            );
+
+            for (unsigned width = 1; width < parts; width *= 2)
+            {
+               pool->run(
+                  [&](unsigned i)
+                  {
+                     if (i % (2 * width) || i + width >= parts)
+                        return;
+
+                     auto lo = SplitPool::part(n, parts, i).first;
+                     auto mid = SplitPool::part(n, parts, i + width).first;
+                     auto hi = SplitPool::part(n, parts, std::min(i + 2 * width, parts) - 1).second;
+                     std::inplace_merge(b + lo, b + mid, b + hi);
+                  }
+               );
+            }
+         }
+         break;
+
+      default:
+#if PARALLEL_POLICIES
+         withPolicy(mode, [&](auto const& policy) { std::sort(policy, b, e); });
+#endif
+         break;
+      }
+
+      return data[data.size() / 2];
+   }
+
+   std::vector<std::uint32_t> input;
+   std::vector<std::uint32_t> data;
+};
+
+
+struct Reduce
+{
+   static constexpr char const* kName = "std::reduce of double";
+
+   Reduce(std::size_t n)
+      : data(n)
+   {
+      Benchmark::Random r(1);
+      for (auto& x: data)
+         x = r.real();
+   }
+
+   void prepare()
+   {}
+
+   Value run(Mode mode, SplitPool* pool)
+   {
+      auto b = data.begin();
+      auto e = data.end();
+      double sum = 0;
+
+      switch (mode)
+      {
+      case Mode::Serial:
+         sum = std::reduce(b, e, 0.0);
+         break;
+
+      case Mode::Split:
+         {
+            struct alignas(64) Partial
+            {
+               double sum;
+            };
+
+            auto n = data.size();
+            auto parts = pool->size();
+            std::vector<Partial> partials(parts);
+            pool->run(
+               [&](unsigned i)
+               {
+                  auto [lo, hi] = SplitPool::part(n, parts, i);
+                  partials[i].sum = std::reduce(b + lo, b + hi, 0.0);
+               }
+            );
+
+            for (auto const& p: partials)
+               sum += p.sum;
+         }
+         break;
+
+      default:
+#if PARALLEL_POLICIES
+         sum = withPolicy(mode, [&](auto const& policy) { return std::reduce(policy, b, e, 0.0); });
+#endif
+         break;
+      }
+
+      return Value(sum);
+   }
+
+   std::vector<double> data;
+};
+
+
+struct Transform
+{
+   static constexpr char const* kName = "std::transform of double, sqrt(x) * 3 + 1";
+
+   Transform(std::size_t n)
+      : input(n)
+      , output(n)
+   {
+      Benchmark::Random r(1);
+      for (auto& x: input)
+         x = r.real();
+   }
+
+   void prepare()
+   {}
+
+   static double f(double x) noexcept
+   {
+      return std::sqrt(x) * 3.0 + 1.0;
+   }
+
+   Value run(Mode mode, SplitPool* pool)
+   {
+      auto b = input.begin();
+      auto e = input.end();
+      auto out = output.begin();
+
+      switch (mode)
+      {
+      case Mode::Serial:
+         std::transform(b, e, out, f);
+         break;
+
+      case Mode::Split:
+         {
+            auto n = input.size();
+            auto parts = pool->size();
+            pool->run(
+               [&](unsigned i)
+               {
+                  auto [lo, hi] = SplitPool::part(n, parts, i);
+                  std::transform(b + lo, b + hi, out + lo, f);
+               }
+            );
+         }
+         break;
+
+      default:
+#if PARALLEL_POLICIES
+         withPolicy(mode, [&](auto const& policy) { std::transform(policy, b, e, out, f); });
+#endif
+         break;
+      }
+
+      return Value(output[output.size() / 2]);
+   }
+
+   std::vector<double> input;
+   std::vector<double> output;
+};
+
+
+// the serial row's time, which the other rows of a table compare to
+struct Baseline
+{
+   std::uint64_t ns = 0;
+};
+
+
+// one algorithm call per iteration, after restoring its input
+template <class Algorithm>
+class Parallel final
+   : public Benchmark::Fixture
+{
+public:
+   Parallel(
+      std::size_t size,
+      Mode mode,
+      unsigned splitThreads,
+      std::shared_ptr<Baseline> baseline
+   )
+      : m_size(size)
+      , m_mode(mode)
+      , m_splitThreads(splitThreads)
+      , m_baseline(std::move(baseline))
+   {}
+
+   void initialize(unsigned) override
+   {
+      m_algorithm = std::make_unique<Algorithm>(m_size);
+      if (m_mode == Mode::Split)
+         m_pool = std::make_unique<SplitPool>(m_splitThreads);
+
+      m_elapsed = 0;
+   }
+
+   void finalize() override
+   {
+      m_pool.reset();
+      m_algorithm.reset();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      Benchmark::Stopwatch<Benchmark::TimestampProvider> sw;
+      sw.start();
+
+      Value r = 0;
+      while (iterations--)
+      {
+         m_algorithm->prepare();
+         r += m_algorithm->run(m_mode, m_pool.get());
+      }
+
+      m_elapsed += std::uint64_t(sw.stop().count());
+      g_dontOptimize = r;
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      if (m_mode == Mode::Serial)
+         m_baseline->ns = m_elapsed;
+
+      // 100 * serial time / wall time, i.e. the speedup in %
+      if (m_baseline->ns)
+      {
+         m.push_back({
+            "% serial speed",
+            double(m_baseline->ns) / 1e7,
+            Benchmark::Metric::Kind::Rate
+         });
+      }
+   }
+
+private:
+   static inline volatile Value g_dontOptimize = 0;
+
+   std::size_t const m_size;
+   Mode const m_mode;
+   unsigned const m_splitThreads;
+   std::shared_ptr<Baseline> m_baseline;
+   std::unique_ptr<Algorithm> m_algorithm;
+   std::unique_ptr<SplitPool> m_pool;
+   std::uint64_t m_elapsed = 0;
+};
+
+
+std::string sizeName(std::size_t n)
+{
+   if (n >= 1000000 && n % 1000000 == 0)
+      return std::to_string(n / 1000000) + "M";
+
+   if (n >= 1000 && n % 1000 == 0)
+      return std::to_string(n / 1000) + "K";
+
+   return std::to_string(n);
+}
+
+
+// one table per size, serial first
+template <class Algorithm>
+void runAlgorithm(
+   std::uint64_t elementsPerRow,
+   std::size_t maxSize,
+   unsigned maxSplitThreads
+)
+{
+   for (std::size_t size = 1000; size <= maxSize; size *= 10)
+   {
+      auto baseline = std::make_shared<Baseline>();
+
+      Benchmark::Runner r(
+         std::string(Algorithm::kName) + ", " + sizeName(size) + " elements",
+         std::max<std::uint64_t>(1, elementsPerRow / size)
+      );
+
+      r.add(
+         "serial",
+         Benchmark::Fixture::make<Parallel<Algorithm>>(size, Mode::Serial, 1u, baseline)
+      );
+
+#if PARALLEL_POLICIES
+      r.add(
+         "std::execution::par",
+         Benchmark::Fixture::make<Parallel<Algorithm>>(size, Mode::Par, 1u, baseline)
+      );
+
+      r.add(
+         "std::execution::par_unseq",
+         Benchmark::Fixture::make<Parallel<Algorithm>>(size, Mode::ParUnseq, 1u, baseline)
+      );
+#endif
+
+      for (unsigned t = 2; t <= maxSplitThreads; t *= 2)
+      {
+         r.add(
+            "manual split, " + std::to_string(t) + " threads",
+            Benchmark::Fixture::make<Parallel<Algorithm>>(size, Mode::Split, t, baseline)
+         );
+      }
+
+      r.run();
+   }
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+
+   // elements processed per row, which sets each table's iterations
+   std::uint64_t elements = 20000000ULL;
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      elements,
+      "-n must be a positive integer"
+   );
+
+   std::uint64_t maxSize = 100000000ULL;
+   Benchmark::bindArg(
+      cmd,
+      "-m",
+      maxSize,
+      "-m must be a positive integer"
+   );
+
+   unsigned maxSplitThreads = std::max(2u, std::thread::hardware_concurrency());
+   Benchmark::bindArg(
+      cmd,
+      "-t",
+      maxSplitThreads,
+      "-t must be a positive integer"
+   );
+
+   runAlgorithm<Sort>(elements, maxSize, maxSplitThreads);
+   runAlgorithm<Reduce>(elements, maxSize, maxSplitThreads);
+   runAlgorithm<Transform>(elements, maxSize, maxSplitThreads);
+
+   return 0;
+}
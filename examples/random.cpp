@@ -0,0 +1,382 @@
+//
+// random number generation for fixture setup: Benchmark::Random against
+// std::mt19937_64, PCG32 and splitmix64, bounded draws by modulo and by
+// multiply-shift, batch fills, and the distribution helpers
+//
+//    random [-n <iterations>] [-b <bound>]
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+
+namespace
+{
+
+
+//
+// generators; sources that are not bounded ignore max
+//
+
+struct Xorshift
+{
+   std::uint64_t operator()(std::uint64_t) noexcept
+   {
+      return r();
+   }
+
+   Benchmark::Random r{ 1 };
+};
+
+struct Mt19937
+{
+   std::uint64_t operator()(std::uint64_t) noexcept
+   {
+      return g();
+   }
+
+   std::mt19937_64 g{ 1 };
+};
+
+// O'Neill's PCG32 (XSH-RR): 32 bits per draw
+struct Pcg32
+{
+   std::uint64_t operator()(std::uint64_t) noexcept
+   {
+      auto old = state;
+      state = old * 6364136223846793005ULL + increment;
+      auto xorshifted = std::uint32_t(((old >> 18) ^ old) >> 27);
+      auto rot = unsigned(old >> 59);
+      return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+   }
+
+   std::uint64_t state = 0x853C49E6748FEA9BULL;
+   std::uint64_t increment = 0xDA3E39CB94B95BDBULL;
+};
+
+struct SplitMix64
+{
+   std::uint64_t operator()(std::uint64_t) noexcept
+   {
+      auto z = (state += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+   }
+
+   std::uint64_t state = 1;
+};
+
+
+//
+// bounded draws in [0, max]
+//
+
+// what Benchmark::Random used to do: biased, and a 64-bit divide
+struct Modulo
+{
+   std::uint64_t operator()(std::uint64_t max) noexcept
+   {
+      return r() % (max + 1);
+   }
+
+   Benchmark::Random r{ 1 };
+};
+
+struct MultiplyShift
+{
+   std::uint64_t operator()(std::uint64_t max) noexcept
+   {
+      return r(max);
+   }
+
+   Benchmark::Random r{ 1 };
+};
+
+struct StdUniform
+{
+   std::uint64_t operator()(std::uint64_t max) noexcept
+   {
+      return std::uniform_int_distribution<std::uint64_t>(0, max)(g);
+   }
+
+   std::mt19937_64 g{ 1 };
+};
+
+
+//
+// distributions; max is the Zipf population
+//
+
+struct Exponential
+{
+   double operator()(std::uint64_t) noexcept
+   {
+      return d(r);
+   }
+
+   Benchmark::Random r{ 1 };
+   Benchmark::Exponential d{ 2.0 };
+};
+
+struct StdExponential
+{
+   double operator()(std::uint64_t) noexcept
+   {
+      return d(g);
+   }
+
+   std::mt19937_64 g{ 1 };
+   std::exponential_distribution<double> d{ 2.0 };
+};
+
+struct Normal
+{
+   double operator()(std::uint64_t) noexcept
+   {
+      return d(r);
+   }
+
+   Benchmark::Random r{ 1 };
+   Benchmark::Normal d;
+};
+
+struct StdNormal
+{
+   double operator()(std::uint64_t) noexcept
+   {
+      return d(g);
+   }
+
+   std::mt19937_64 g{ 1 };
+   std::normal_distribution<double> d;
+};
+
+struct Zipf
+{
+   std::uint64_t operator()(std::uint64_t max) noexcept
+   {
+      if (!d)
+         d = std::make_unique<Benchmark::Zipf>(max + 1);
+
+      return (*d)(r);
+   }
+
+   Benchmark::Random r{ 1 };
+   std::unique_ptr<Benchmark::Zipf> d;
+};
+
+
+class Fixture
+   : public Benchmark::Fixture
+{
+protected:
+   static volatile std::uint64_t g_dontOptimize;
+};
+
+volatile std::uint64_t Fixture::g_dontOptimize = 0;
+
+
+// an iteration is one draw
+template <class Source>
+class Draws final
+   : public Fixture
+{
+public:
+   Draws(std::uint64_t max) noexcept
+      : m_max(max)
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      Source source;
+      auto max = m_max;
+
+      using T = decltype(source(max));
+      T acc = 0;
+      while (iterations--)
+      {
+         if constexpr (std::is_floating_point_v<T>)
+            acc += source(max);
+         else
+            acc ^= source(max);
+      }
+
+      g_dontOptimize = std::uint64_t(acc);
+      return 0;
+   }
+
+private:
+   std::uint64_t const m_max;
+};
+
+
+//
+// batches of values into a buffer
+//
+
+template <class T>
+void loopRandom(Benchmark::Random& r, std::span<T> out, std::uint64_t)
+{
+   for (auto& x: out)
+      x = T(r());
+}
+
+template <class T>
+void loopBounded(Benchmark::Random& r, std::span<T> out, std::uint64_t max)
+{
+   for (auto& x: out)
+      x = r(T(max));
+}
+
+template <class T>
+void loopReal(Benchmark::Random& r, std::span<T> out, std::uint64_t)
+{
+   for (auto& x: out)
+      x = T(r.real());
+}
+
+template <class T>
+void fill(Benchmark::Random& r, std::span<T> out, std::uint64_t)
+{
+   r.fill(out);
+}
+
+template <class T>
+void fillBounded(Benchmark::Random& r, std::span<T> out, std::uint64_t max)
+{
+   r.fill(out, T(max));
+}
+
+
+// an iteration is one value
+template <class T, void (*Fill)(Benchmark::Random&, std::span<T>, std::uint64_t)>
+class Batch final
+   : public Fixture
+{
+public:
+   static constexpr std::size_t kBatch = 4096;
+
+   Batch(std::uint64_t max)
+      : m_max(max)
+      , m_buffer(kBatch)
+   {}
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      Benchmark::Random r(1);
+      while (iterations)
+      {
+         auto n = std::min<Benchmark::Counter>(iterations, kBatch);
+         Fill(r, std::span<T>(m_buffer.data(), n), m_max);
+         iterations -= n;
+      }
+
+      g_dontOptimize = std::uint64_t(m_buffer[kBatch / 2]);
+      return 0;
+   }
+
+private:
+   std::uint64_t const m_max;
+   std::vector<T> m_buffer;
+};
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+
+   std::uint64_t iterations = 100000000ULL;
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   // a runtime value, so the modulo cannot become a multiplication
+   std::uint64_t bound = 1000;
+   Benchmark::bindArg(
+      cmd,
+      "-b",
+      bound,
+      "-b must be a positive integer"
+   );
+
+   auto const max = bound - 1;
+
+   {
+      Benchmark::Runner r("Generators, one draw", iterations);
+      r.add("Benchmark::Random (xorshift64*)", Benchmark::Fixture::make<Draws<Xorshift>>(max));
+      r.add("std::mt19937_64", Benchmark::Fixture::make<Draws<Mt19937>>(max));
+      r.add("PCG32 (32 bits)", Benchmark::Fixture::make<Draws<Pcg32>>(max));
+      r.add("splitmix64", Benchmark::Fixture::make<Draws<SplitMix64>>(max));
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Bounded draws in [0, " + std::to_string(max) + "]", iterations);
+      r.add("r() % (max + 1)", Benchmark::Fixture::make<Draws<Modulo>>(max));
+      r.add("r(max), multiply-shift", Benchmark::Fixture::make<Draws<MultiplyShift>>(max));
+      r.add(
+         "std::uniform_int_distribution, mt19937_64",
+         Benchmark::Fixture::make<Draws<StdUniform>>(max)
+      );
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Filling buffers, per value", iterations);
+      r.add("loop of r()", Benchmark::Fixture::make<Batch<std::uint64_t, loopRandom>>(max));
+      r.add("fill(span<uint64_t>)", Benchmark::Fixture::make<Batch<std::uint64_t, fill>>(max));
+      r.add("loop of r(max)", Benchmark::Fixture::make<Batch<std::uint32_t, loopBounded>>(max));
+      r.add(
+         "fill(span<uint32_t>, max)",
+         Benchmark::Fixture::make<Batch<std::uint32_t, fillBounded>>(max)
+      );
+      r.add("loop of r.real()", Benchmark::Fixture::make<Batch<double, loopReal>>(max));
+      r.add("fill(span<double>)", Benchmark::Fixture::make<Batch<double, fill>>(max));
+      r.add("fill(span<float>)", Benchmark::Fixture::make<Batch<float, fill>>(max));
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Distributions", iterations);
+      r.add("Benchmark::Exponential", Benchmark::Fixture::make<Draws<Exponential>>(max));
+      r.add(
+         "std::exponential_distribution, mt19937_64",
+         Benchmark::Fixture::make<Draws<StdExponential>>(max)
+      );
+      r.add("Benchmark::Normal", Benchmark::Fixture::make<Draws<Normal>>(max));
+      r.add(
+         "std::normal_distribution, mt19937_64",
+         Benchmark::Fixture::make<Draws<StdNormal>>(max)
+      );
+      r.add(
+         "Benchmark::Zipf over " + std::to_string(bound),
+         Benchmark::Fixture::make<Draws<Zipf>>(max)
+      );
+      r.run();
+   }
+
+   return 0;
+}
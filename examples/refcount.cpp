@@ -0,0 +1,689 @@
+//
+// reference counting under contention: std::shared_ptr creation, copies
+// of one control block from many threads, std::atomic<std::shared_ptr>,
+// and intrusive, biased and deferred (per-thread) counts
+//
+//    refcount [-n <iterations>]
+//
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "benchmark/allocstats.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+
+BM_COUNT_ALLOCATIONS()
+
+
+namespace
+{
+
+
+constexpr std::size_t kCacheLine = 64;
+
+struct Payload
+{
+   explicit Payload(std::uint64_t v) noexcept
+      : value(v)
+   {}
+
+   std::uint64_t value;
+};
+
+// keeps neighbouring roots off each other's cache line
+template <class T>
+struct alignas(kCacheLine) Padded
+{
+   T v;
+};
+
+
+//
+// intrusive: the count lives in the object, one allocation, no control
+// block, as boost::intrusive_ptr
+//
+
+struct IntrusiveNode
+{
+   explicit IntrusiveNode(std::uint64_t v) noexcept
+      : value(v)
+   {}
+
+   std::atomic<std::uint32_t> refs = 1;
+   std::uint64_t value;
+};
+
+class IntrusivePtr final
+{
+public:
+   IntrusivePtr() noexcept = default;
+
+   explicit IntrusivePtr(IntrusiveNode* p) noexcept
+      : m_p(p)
+   {}
+
+   IntrusivePtr(IntrusivePtr const& o) noexcept
+      : m_p(o.m_p)
+   {
+      if (m_p)
+         m_p->refs.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   IntrusivePtr& operator=(IntrusivePtr const&) = delete;
+
+   ~IntrusivePtr()
+   {
+      if (m_p && m_p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+         delete m_p;
+   }
+
+   IntrusiveNode* operator->() const noexcept
+   {
+      return m_p;
+   }
+
+private:
+   IntrusiveNode* m_p = nullptr;
+};
+
+
+//
+// biased (Choi et al.): the owning thread counts without atomics, the
+// others share an atomic count that holds one extra reference for as
+// long as the owner has any
+//
+
+struct BiasedNode
+{
+   BiasedNode(std::uint64_t v, Benchmark::Tid owner) noexcept
+      : owner(owner)
+      , value(v)
+   {}
+
+   // on its own line, so the owner's plain stores stay in its cache
+   alignas(kCacheLine) std::uint32_t local = 0;
+   alignas(kCacheLine) std::atomic<std::uint32_t> shared = 0;
+   Benchmark::Tid const owner;
+   std::uint64_t const value;
+};
+
+class BiasedPtr final
+{
+public:
+   BiasedPtr(BiasedNode* p, Benchmark::Tid tid) noexcept
+      : m_p(p)
+      , m_tid(tid)
+   {
+      acquire();
+   }
+
+   BiasedPtr(BiasedPtr const& o, Benchmark::Tid tid) noexcept
+      : BiasedPtr(o.m_p, tid)
+   {}
+
+   BiasedPtr(BiasedPtr const&) = delete;
+   BiasedPtr& operator=(BiasedPtr const&) = delete;
+
+   ~BiasedPtr()
+   {
+      if (m_tid == m_p->owner && --m_p->local)
+         return;
+
+      if (m_p->shared.fetch_sub(1, std::memory_order_acq_rel) == 1)
+         delete m_p;
+   }
+
+   BiasedNode* operator->() const noexcept
+   {
+      return m_p;
+   }
+
+private:
+   void acquire() noexcept
+   {
+      if (m_tid == m_p->owner && m_p->local++)
+         return;
+
+      m_p->shared.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   BiasedNode* const m_p;
+   Benchmark::Tid const m_tid;
+};
+
+
+//
+// deferred: a count per thread, as the kernel's percpu_ref; summing
+// them when the owner tears the object down is the rare slow path and
+// not measured here
+//
+
+class DeferredNode final
+{
+public:
+   DeferredNode(std::uint64_t v, unsigned threads)
+      : value(v)
+      , m_counts(threads)
+   {}
+
+   std::uint64_t const value;
+
+   void acquire(Benchmark::Tid tid) noexcept
+   {
+      auto& c = m_counts[tid].v;
+      c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+   }
+
+   void release(Benchmark::Tid tid) noexcept
+   {
+      auto& c = m_counts[tid].v;
+      c.store(c.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+   }
+
+private:
+   // a thread only writes its own slot
+   std::vector<Padded<std::atomic<std::int64_t>>> m_counts;
+};
+
+
+//
+// schemes: a copy is taken from a root, dereferenced, and dropped;
+// roots are shared by all threads, or one per thread for comparison
+//
+
+class SharedPtr
+{
+public:
+   void initialize(unsigned roots)
+   {
+      m_roots.clear();
+      for (unsigned i = 0; i < roots; ++i)
+         m_roots.push_back({ std::make_shared<Payload>(i) });
+   }
+
+   std::uint64_t touch(unsigned root, Benchmark::Tid, std::uint64_t) noexcept
+   {
+      auto copy = m_roots[root].v;
+      return copy->value;
+   }
+
+private:
+   std::vector<Padded<std::shared_ptr<Payload>>> m_roots;
+};
+
+class Intrusive
+{
+public:
+   void initialize(unsigned roots)
+   {
+      m_roots.clear();
+      for (unsigned i = 0; i < roots; ++i)
+         m_roots.push_back({ IntrusivePtr(new IntrusiveNode(i)) });
+   }
+
+   std::uint64_t touch(unsigned root, Benchmark::Tid, std::uint64_t) noexcept
+   {
+      auto copy = m_roots[root].v;
+      return copy->value;
+   }
+
+private:
+   std::vector<Padded<IntrusivePtr>> m_roots;
+};
+
+// the shared root is owned by thread 0, a per-thread root by its thread
+class Biased
+{
+public:
+   void initialize(unsigned roots)
+   {
+      m_roots.clear();
+      for (unsigned i = 0; i < roots; ++i)
+         m_roots.push_back(std::make_unique<BiasedPtr>(new BiasedNode(i, i), i));
+   }
+
+   std::uint64_t touch(unsigned root, Benchmark::Tid tid, std::uint64_t) noexcept
+   {
+      BiasedPtr copy(*m_roots[root], tid);
+      return copy->value;
+   }
+
+private:
+   // the roots were taken on the main thread as if by the owner
+   std::vector<std::unique_ptr<BiasedPtr>> m_roots;
+};
+
+class Deferred
+{
+public:
+   void initialize(unsigned roots, unsigned threads)
+   {
+      m_roots.clear();
+      for (unsigned i = 0; i < roots; ++i)
+         m_roots.push_back(std::make_unique<DeferredNode>(i, threads));
+   }
+
+   std::uint64_t touch(unsigned root, Benchmark::Tid tid, std::uint64_t) noexcept
+   {
+      auto& node = *m_roots[root];
+      node.acquire(tid);
+      auto v = node.value;
+      node.release(tid);
+      return v;
+   }
+
+private:
+   std::vector<std::unique_ptr<DeferredNode>> m_roots;
+};
+
+
+//
+// publishing a pointer: readers take a reference to the current
+// object while, in the mixed rows, every 16th operation replaces it
+//
+
+constexpr std::uint64_t kStoreEvery = 16;
+
+class PublishBase
+{
+public:
+   void initialize(unsigned, bool stores)
+   {
+      m_versions[0] = std::make_shared<Payload>(0);
+      m_versions[1] = std::make_shared<Payload>(1);
+      m_stores = stores;
+   }
+
+protected:
+   bool store(std::uint64_t i) const noexcept
+   {
+      return m_stores && i % kStoreEvery == 0;
+   }
+
+   std::shared_ptr<Payload> m_versions[2];
+   bool m_stores = false;
+};
+
+#if __cpp_lib_atomic_shared_ptr
+
+class AtomicSharedPtr
+   : public PublishBase
+{
+public:
+   void initialize(unsigned threads, bool stores)
+   {
+      PublishBase::initialize(threads, stores);
+      m_current.store(m_versions[0]);
+   }
+
+   std::uint64_t touch(unsigned, Benchmark::Tid, std::uint64_t i) noexcept
+   {
+      if (store(i))
+      {
+         m_current.store(m_versions[i / kStoreEvery % 2]);
+         return 0;
+      }
+
+      auto copy = m_current.load();
+      return copy->value;
+   }
+
+private:
+   alignas(kCacheLine) std::atomic<std::shared_ptr<Payload>> m_current;
+};
+
+#endif // __cpp_lib_atomic_shared_ptr
+
+class MutexSharedPtr
+   : public PublishBase
+{
+public:
+   void initialize(unsigned threads, bool stores)
+   {
+      PublishBase::initialize(threads, stores);
+      m_current = m_versions[0];
+   }
+
+   std::uint64_t touch(unsigned, Benchmark::Tid, std::uint64_t i) noexcept
+   {
+      if (store(i))
+      {
+         std::lock_guard lock(m_mu);
+         m_current = m_versions[i / kStoreEvery % 2];
+         return 0;
+      }
+
+      std::shared_ptr<Payload> copy;
+      {
+         std::lock_guard lock(m_mu);
+         copy = m_current;
+      }
+
+      return copy->value;
+   }
+
+private:
+   alignas(kCacheLine) std::mutex m_mu;
+   std::shared_ptr<Payload> m_current;
+};
+
+// a raw pointer: no ownership, so no safe reclamation either
+class AtomicRawPtr
+   : public PublishBase
+{
+public:
+   void initialize(unsigned threads, bool stores)
+   {
+      PublishBase::initialize(threads, stores);
+      m_current.store(m_versions[0].get());
+   }
+
+   std::uint64_t touch(unsigned, Benchmark::Tid, std::uint64_t i) noexcept
+   {
+      if (store(i))
+      {
+         m_current.store(m_versions[i / kStoreEvery % 2].get(), std::memory_order_release);
+         return 0;
+      }
+
+      return m_current.load(std::memory_order_acquire)->value;
+   }
+
+private:
+   alignas(kCacheLine) std::atomic<Payload*> m_current = nullptr;
+};
+
+
+//
+// fixtures
+//
+
+class Fixture
+   : public Benchmark::Fixture
+{
+public:
+   void initialize(unsigned) override
+   {
+      m_ops = 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({ "ops/s", double(m_ops.load(std::memory_order_relaxed)), Benchmark::Metric::Kind::Rate });
+   }
+
+protected:
+   void done(std::uint64_t ops) noexcept
+   {
+      m_ops.fetch_add(ops, std::memory_order_relaxed);
+   }
+
+   static volatile std::uint64_t g_dontOptimize;
+
+private:
+   alignas(kCacheLine) std::atomic<std::uint64_t> m_ops = 0;
+};
+
+volatile std::uint64_t Fixture::g_dontOptimize = 0;
+
+
+enum class Roots
+{
+   Shared,
+   PerThread
+};
+
+// an iteration is one copy, dereference and release
+template <class Scheme>
+class CopyDestroy final
+   : public Fixture
+{
+public:
+   CopyDestroy(Roots roots) noexcept
+      : m_roots(roots)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      Fixture::initialize(threads);
+
+      auto roots = m_roots == Roots::Shared ? 1 : threads;
+      if constexpr (std::is_same_v<Scheme, Deferred>)
+         m_scheme.initialize(roots, threads);
+      else
+         m_scheme.initialize(roots);
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      auto root = m_roots == Roots::Shared ? 0 : tid;
+
+      std::uint64_t sum = 0;
+      for (std::uint64_t i = 0; i < iterations; ++i)
+         sum += m_scheme.touch(root, tid, i);
+
+      g_dontOptimize = sum;
+      done(iterations);
+      return 0;
+   }
+
+private:
+   Roots const m_roots;
+   Scheme m_scheme;
+};
+
+// an iteration is one load, or in the mixed rows sometimes a store
+template <class Scheme>
+class Publish final
+   : public Fixture
+{
+public:
+   Publish(bool stores) noexcept
+      : m_stores(stores)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      Fixture::initialize(threads);
+      m_scheme.initialize(threads, m_stores);
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      std::uint64_t sum = 0;
+      for (std::uint64_t i = 0; i < iterations; ++i)
+         sum += m_scheme.touch(0, tid, i + tid);
+
+      g_dontOptimize = sum;
+      done(iterations);
+      return 0;
+   }
+
+private:
+   bool const m_stores;
+   Scheme m_scheme;
+};
+
+
+// an iteration creates and destroys one object
+template <class Make>
+class Create final
+   : public Fixture
+{
+public:
+   void initialize(unsigned threads) override
+   {
+      Fixture::initialize(threads);
+
+      // counted here, untimed, so the timed rows allocate at full speed
+      Benchmark::AllocStats::Scope counting;
+      auto before = Benchmark::AllocStats::bytes;
+      auto allocations = Benchmark::AllocStats::allocations;
+      {
+         auto p = Make{}(0);
+         m_bytes = Benchmark::AllocStats::bytes - before;
+         m_allocations = Benchmark::AllocStats::allocations - allocations;
+      }
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      std::uint64_t sum = 0;
+      for (std::uint64_t i = 0; i < iterations; ++i)
+      {
+         auto p = Make{}(i);
+         sum += p->value;
+      }
+
+      g_dontOptimize = sum;
+      done(iterations);
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({ "allocations/object", double(m_allocations) });
+      m.push_back({ "heap B/object", double(m_bytes) });
+   }
+
+private:
+   std::int64_t m_bytes = 0;
+   std::uint64_t m_allocations = 0;
+};
+
+struct MakeShared
+{
+   auto operator()(std::uint64_t v) const
+   {
+      return std::make_shared<Payload>(v);
+   }
+};
+
+struct SharedFromNew
+{
+   auto operator()(std::uint64_t v) const
+   {
+      return std::shared_ptr<Payload>(new Payload(v));
+   }
+};
+
+struct MakeUnique
+{
+   auto operator()(std::uint64_t v) const
+   {
+      return std::make_unique<Payload>(v);
+   }
+};
+
+struct MakeIntrusive
+{
+   auto operator()(std::uint64_t v) const
+   {
+      return IntrusivePtr(new IntrusiveNode(v));
+   }
+};
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t iterations = 10000000ULL;
+
+   // only Create's untimed sample counts
+   Benchmark::AllocStats::enabled = false;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   std::vector<unsigned> const threads = { 1, 2, 4, 8 };
+
+   {
+      Benchmark::Runner r("Creating and destroying an object", iterations);
+      r.add("std::make_shared", Benchmark::Fixture::make<Create<MakeShared>>());
+      r.add("std::shared_ptr(new T)", Benchmark::Fixture::make<Create<SharedFromNew>>());
+      r.add("intrusive, new T", Benchmark::Fixture::make<Create<MakeIntrusive>>());
+      r.add("std::make_unique", Benchmark::Fixture::make<Create<MakeUnique>>());
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Copy and release, one object shared by all threads", iterations);
+      r.add(
+         "std::shared_ptr copy",
+         Benchmark::Fixture::make<CopyDestroy<SharedPtr>>(Roots::Shared),
+         threads
+      );
+      r.add(
+         "std::shared_ptr copy, object per thread",
+         Benchmark::Fixture::make<CopyDestroy<SharedPtr>>(Roots::PerThread),
+         threads
+      );
+      r.add(
+         "intrusive count",
+         Benchmark::Fixture::make<CopyDestroy<Intrusive>>(Roots::Shared),
+         threads
+      );
+      r.add(
+         "biased count, thread 0 owns",
+         Benchmark::Fixture::make<CopyDestroy<Biased>>(Roots::Shared),
+         threads
+      );
+      r.add(
+         "deferred, per-thread counts",
+         Benchmark::Fixture::make<CopyDestroy<Deferred>>(Roots::Shared),
+         threads
+      );
+      r.run();
+   }
+
+   for (bool stores: { false, true })
+   {
+      Benchmark::Runner r(
+         stores ? "Publishing a pointer, 1 store per 16 loads" : "Publishing a pointer, loads only",
+         iterations
+      );
+
+#if __cpp_lib_atomic_shared_ptr
+      r.add(
+         "std::atomic<std::shared_ptr>",
+         Benchmark::Fixture::make<Publish<AtomicSharedPtr>>(stores),
+         threads
+      );
+#endif
+      r.add(
+         "std::mutex + std::shared_ptr",
+         Benchmark::Fixture::make<Publish<MutexSharedPtr>>(stores),
+         threads
+      );
+      r.add(
+         "std::atomic<T*>, no ownership",
+         Benchmark::Fixture::make<Publish<AtomicRawPtr>>(stores),
+         threads
+      );
+      r.run();
+   }
+
+   return 0;
+}
@@ -1,5 +1,11 @@
 
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
 #include <typeinfo>
+#include <utility>
+#include <vector>
 
 #include "benchmark/runner.hpp"
 #include "benchmark/random.hpp"
@@ -31,25 +37,60 @@ struct Fixture :
       m_next = 0;
    }
 
-protected:
+   // kinds for LLVM-style isa<>/dyn_cast<>
+   enum class Kind : std::uint8_t
+   {
+      A,
+      B,
+      AB,
+      BA,
+      C
+   };
+
+   //
+   // type ids are assigned so that the subtypes of any class
+   // form a contiguous range [kFirst, kLast]:
+   //    A = 1, AB = 2, BA = 3, B = 4, C = 5
+   //
+   static constexpr std::uint32_t kTypeIds = 6;
+
    struct Base
    {
       virtual ~Base() = default;
 
-      constexpr Base() noexcept
+      constexpr Base(Kind kind, std::uint32_t typeId, void* self) noexcept
          : m_name("Base")
+         , m_kind(kind)
+         , m_typeId(typeId)
+         , m_self(self)
       {;
       }
 
       virtual const char* type() const noexcept = 0;
 
       const char* m_name;
+
+      // Base is a virtual base, so it can't be static_cast down;
+      // casts go through the most derived object instead
+      Kind const m_kind;
+      std::uint32_t const m_typeId;
+      void* const m_self;
    };
 
    struct A : virtual public Base
    {
+      static constexpr std::uint32_t kId = 1;
+      static constexpr std::uint32_t kFirst = 1;
+      static constexpr std::uint32_t kLast = 3;
+
+      static bool classof(Base const* b) noexcept
+      {
+         return b->m_kind == Kind::A || b->m_kind == Kind::AB || b->m_kind == Kind::BA;
+      }
+
       A() noexcept
-         : m_name("A")
+         : Base(Kind::A, kId, this)
+         , m_name("A")
       {
       }
 
@@ -63,8 +104,18 @@ protected:
 
    struct B : virtual public Base
    {
+      static constexpr std::uint32_t kId = 4;
+      static constexpr std::uint32_t kFirst = 2;
+      static constexpr std::uint32_t kLast = 4;
+
+      static bool classof(Base const* b) noexcept
+      {
+         return b->m_kind == Kind::B || b->m_kind == Kind::AB || b->m_kind == Kind::BA;
+      }
+
       B() noexcept
-         : m_name("B")
+         : Base(Kind::B, kId, this)
+         , m_name("B")
       {
       }
 
@@ -79,8 +130,18 @@ protected:
 
    struct AB : public A, public B
    {
+      static constexpr std::uint32_t kId = 2;
+      static constexpr std::uint32_t kFirst = 2;
+      static constexpr std::uint32_t kLast = 2;
+
+      static bool classof(Base const* b) noexcept
+      {
+         return b->m_kind == Kind::AB;
+      }
+
       AB() noexcept
-         : m_name("AB")
+         : Base(Kind::AB, kId, this)
+         , m_name("AB")
       {
       }
 
@@ -94,12 +155,48 @@ protected:
 
    struct BA : public B, public A
    {
+      static constexpr std::uint32_t kId = 3;
+      static constexpr std::uint32_t kFirst = 3;
+      static constexpr std::uint32_t kLast = 3;
+
+      static bool classof(Base const* b) noexcept
+      {
+         return b->m_kind == Kind::BA;
+      }
+
       ~BA()
       {
       }
 
       BA() noexcept
-         : m_name("BA")
+         : Base(Kind::BA, kId, this)
+         , m_name("BA")
+      {
+      }
+
+      const char* type() const noexcept override
+      {
+         return m_name;
+      }
+
+      const char* m_name;
+   };
+
+   // never instantiated: every cast to C fails
+   struct C final : virtual public Base
+   {
+      static constexpr std::uint32_t kId = 5;
+      static constexpr std::uint32_t kFirst = 5;
+      static constexpr std::uint32_t kLast = 5;
+
+      static bool classof(Base const* b) noexcept
+      {
+         return b->m_kind == Kind::C;
+      }
+
+      C() noexcept
+         : Base(Kind::C, kId, this)
+         , m_name("C")
       {
       }
 
@@ -111,6 +208,10 @@ protected:
       const char* m_name;
    };
 
+   // indexed by type id
+   using Types = std::tuple<void, A, AB, BA, B, C>;
+
+protected:
    Base* one() noexcept
    {
       auto idx = m_next++;
@@ -119,6 +220,159 @@ protected:
       return m_objs[idx].get();
    }
 
+public:
+   // the most derived object seen as To, if it is one
+   template <class To, class Derived>
+   static To* convert(void* self) noexcept
+   {
+      if constexpr (std::is_convertible_v<Derived*, To*>)
+         return static_cast<Derived*>(self);
+      else
+         return nullptr;
+   }
+
+   template <class To>
+   static bool isa(Base const* b) noexcept
+   {
+      return To::classof(b);
+   }
+
+   template <class To>
+   static To* cast(Base* b) noexcept
+   {
+      switch (b->m_kind)
+      {
+      case Kind::A: return convert<To, A>(b->m_self);
+      case Kind::B: return convert<To, B>(b->m_self);
+      case Kind::AB: return convert<To, AB>(b->m_self);
+      case Kind::BA: return convert<To, BA>(b->m_self);
+      case Kind::C: return convert<To, C>(b->m_self);
+      }
+
+      return nullptr;
+   }
+
+   template <class To>
+   static To* dyn_cast(Base* b) noexcept
+   {
+      return isa<To>(b) ? cast<To>(b) : nullptr;
+   }
+
+   struct DynamicCastScheme
+   {
+      template <class To, class From>
+      static To* cast(From* p) noexcept
+      {
+         return dynamic_cast<To*>(p);
+      }
+   };
+
+   struct KindScheme
+   {
+      template <class To, class From>
+      static To* cast(From* p) noexcept
+      {
+         return dyn_cast<To>(p);
+      }
+   };
+
+   // a range check on the type id, then an offset from the most
+   // derived object looked up by type id
+   struct TypeIdScheme
+   {
+      template <class To, class From>
+      static To* cast(From* p) noexcept
+      {
+         Base* b = p;
+         if (b->m_typeId - To::kFirst > To::kLast - To::kFirst)
+            return nullptr;
+
+         auto self = static_cast<char*>(b->m_self);
+         return reinterpret_cast<To*>(self + offsets<To>()[b->m_typeId]);
+      }
+
+   private:
+      template <class Derived, class To>
+      static std::ptrdiff_t offset() noexcept
+      {
+         if constexpr (std::is_convertible_v<Derived*, To*>)
+         {
+            Derived d;
+            return reinterpret_cast<char*>(static_cast<To*>(&d)) -
+               reinterpret_cast<char*>(&d);
+         }
+         else
+         {
+            return 0;
+         }
+      }
+
+      template <class To>
+      static std::ptrdiff_t const* offsets() noexcept
+      {
+         static auto const table = []<std::size_t... I>(std::index_sequence<I...>)
+         {
+            return std::array<std::ptrdiff_t, kTypeIds>{
+               0,
+               offset<std::tuple_element_t<I + 1, Types>, To>()...
+            };
+         }(std::make_index_sequence<kTypeIds - 1>{});
+
+         return table.data();
+      }
+   };
+
+   //
+   // a per-thread direct-mapped cache of (vptr, target type) -> offset;
+   // misses fall back to dyn_cast<>
+   //
+   // vptr is the first word of a polymorphic (sub)object (Itanium C++ ABI),
+   // so it identifies both the dynamic type and the subobject cast from
+   //
+   struct CachedScheme
+   {
+      template <class To, class From>
+      static To* cast(From* p) noexcept
+      {
+         auto vptr = *reinterpret_cast<void const* const*>(p);
+         auto& e = t_cache[slot(vptr, To::kId)];
+         if (e.vptr != vptr || e.to != To::kId) [[unlikely]]
+         {
+            auto to = dyn_cast<To>(static_cast<Base*>(p));
+            e.vptr = vptr;
+            e.to = To::kId;
+            e.offset = to ?
+               reinterpret_cast<char*>(to) - reinterpret_cast<char*>(p) :
+               kFailed;
+         }
+
+         if (e.offset == kFailed)
+            return nullptr;
+
+         return reinterpret_cast<To*>(reinterpret_cast<char*>(p) + e.offset);
+      }
+
+   private:
+      static constexpr std::size_t kEntries = 64;
+      static constexpr std::ptrdiff_t kFailed = PTRDIFF_MIN;
+
+      struct Entry
+      {
+         void const* vptr = nullptr;
+         std::uint32_t to = 0;
+         std::ptrdiff_t offset = 0;
+      };
+
+      static std::size_t slot(void const* vptr, std::uint32_t to) noexcept
+      {
+         auto v = reinterpret_cast<std::uintptr_t>(vptr) >> 3;
+         return (v ^ (v >> 7) ^ to) & (kEntries - 1);
+      }
+
+      static thread_local Entry t_cache[kEntries];
+   };
+
+protected:
    Benchmark::Random m_rand;
    Benchmark::AnyObjectVector<Base> m_objs;
    std::size_t m_next = 0;
@@ -127,6 +381,7 @@ protected:
 
 
 volatile std::size_t Fixture::g_dontOptimize = 0;
+thread_local Fixture::CachedScheme::Entry Fixture::CachedScheme::t_cache[kEntries];
 
 
 struct DynamicCast
@@ -208,6 +463,79 @@ struct DynamicTypeId
 };
 
 
+// casts every object, seen as From*, to To* with Scheme
+template <class Scheme, class From, class To>
+struct Cast
+   : public Fixture
+{
+   Cast() noexcept = default;
+
+   void initialize(unsigned tid) override
+   {
+      Fixture::initialize(tid);
+
+      for (auto& o: m_objs)
+         m_from.push_back(dynamic_cast<From*>(o.get()));
+   }
+
+   void finalize() override
+   {
+      m_from.clear();
+
+      Fixture::finalize();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter n,
+      Benchmark::Tid
+   ) override
+   {
+      std::uintptr_t k = 0;
+      std::size_t i = 0;
+      auto const size = m_from.size();
+      while (n--)
+      {
+         auto to = Scheme::template cast<To>(m_from[i]);
+         k += reinterpret_cast<std::uintptr_t>(to);
+
+         if (++i == size)
+            i = 0;
+      }
+
+      g_dontOptimize = k;
+      return 0;
+   }
+
+private:
+   std::vector<From*> m_from;
+};
+
+
+template <class From, class To>
+void addCasts(Benchmark::Runner& r)
+{
+   r.add(
+      "dynamic_cast<>()",
+      Fixture::make<Cast<Fixture::DynamicCastScheme, From, To>>()
+   );
+
+   r.add(
+      "isa<>() / dyn_cast<>() on a kind enum",
+      Fixture::make<Cast<Fixture::KindScheme, From, To>>()
+   );
+
+   r.add(
+      "type id range check",
+      Fixture::make<Cast<Fixture::TypeIdScheme, From, To>>()
+   );
+
+   r.add(
+      "vptr-keyed cast cache",
+      Fixture::make<Cast<Fixture::CachedScheme, From, To>>()
+   );
+}
+
+
 } // namespace
 
 int main(int argc, char** argv)
@@ -245,5 +573,23 @@ int main(int argc, char** argv)
 
    r.run();
 
+   {
+      Benchmark::Runner rc("Downcast: Base* -> AB*, half of them fail", iterations);
+      addCasts<Fixture::Base, Fixture::AB>(rc);
+      rc.run();
+   }
+
+   {
+      Benchmark::Runner rc("Failing cast: Base* -> C*", iterations);
+      addCasts<Fixture::Base, Fixture::C>(rc);
+      rc.run();
+   }
+
+   {
+      Benchmark::Runner rc("Cross-cast: A* -> B*", iterations);
+      addCasts<Fixture::A, Fixture::B>(rc);
+      rc.run();
+   }
+
    return 0;
 }
@@ -0,0 +1,639 @@
+//
+// fork/join task scheduling: a pool sharing one locked FIFO against a
+// pool of per-worker Chase-Lev deques with random stealing; the Runner
+// threads are the workers, each running its own root jobs and helping
+// with everyone else's while it waits
+//
+//    scheduler [-n <root jobs per thread>]
+//
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+
+namespace
+{
+
+
+using Value = std::uint64_t;
+
+
+//
+// queues of task pointers; push() may refuse a task, which the
+// spawning worker then runs inline
+//
+
+// one mutex-protected FIFO shared by all workers
+template <class T>
+class CentralQueue final
+{
+public:
+   explicit CentralQueue(unsigned) noexcept
+   {}
+
+   bool push(Benchmark::Tid, T* t)
+   {
+      std::lock_guard l(m_mutex);
+      m_tasks.push_back(t);
+      return true;
+   }
+
+   T* pop(Benchmark::Tid)
+   {
+      std::lock_guard l(m_mutex);
+      if (m_tasks.empty())
+         return nullptr;
+
+      auto t = m_tasks.front();
+      m_tasks.pop_front();
+      return t;
+   }
+
+   T* steal(Benchmark::Tid, Benchmark::Random&) noexcept
+   {
+      return nullptr;
+   }
+
+private:
+   std::mutex m_mutex;
+   std::deque<T*> m_tasks;
+};
+
+
+//
+// Chase-Lev deque with the C11 orderings of Lê et al. (PPoPP 2013);
+// the owner pushes and pops at the bottom, thieves take from the top.
+// Fixed capacity: fork/join depth bounds what a worker holds
+//
+template <class T>
+class ChaseLevDeque final
+{
+public:
+   static constexpr std::int64_t kCapacity = 1 << 13;
+
+   bool push(T* t) noexcept
+   {
+      auto b = m_bottom.load(std::memory_order_relaxed);
+      auto top = m_top.load(std::memory_order_acquire);
+      if (b - top >= kCapacity)
+         return false;
+
+      m_buffer[b & (kCapacity - 1)].store(t, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return true;
+   }
+
+   T* pop() noexcept
+   {
+      auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+      m_bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto top = m_top.load(std::memory_order_relaxed);
+
+      if (top > b)
+      {
+         m_bottom.store(b + 1, std::memory_order_relaxed);
+         return nullptr;
+      }
+
+      auto t = m_buffer[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+      if (top == b)
+      {
+         // the last task: race the thieves for it
+         if (!m_top.compare_exchange_strong(
+               top,
+               top + 1,
+               std::memory_order_seq_cst,
+               std::memory_order_relaxed
+            ))
+         {
+            t = nullptr;
+         }
+
+         m_bottom.store(b + 1, std::memory_order_relaxed);
+      }
+
+      return t;
+   }
+
+   T* steal() noexcept
+   {
+      auto top = m_top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto b = m_bottom.load(std::memory_order_acquire);
+      if (top >= b)
+         return nullptr;
+
+      auto t = m_buffer[top & (kCapacity - 1)].load(std::memory_order_relaxed);
+      if (!m_top.compare_exchange_strong(
+            top,
+            top + 1,
+            std::memory_order_seq_cst,
+            std::memory_order_relaxed
+         ))
+      {
+         return nullptr;
+      }
+
+      return t;
+   }
+
+private:
+   alignas(64) std::atomic<std::int64_t> m_top = 0;
+   alignas(64) std::atomic<std::int64_t> m_bottom = 0;
+   alignas(64) std::atomic<T*> m_buffer[kCapacity] = {};
+};
+
+
+template <class T>
+class WorkStealing final
+{
+public:
+   explicit WorkStealing(unsigned workers)
+   {
+      for (unsigned i = 0; i < workers; ++i)
+         m_deques.push_back(std::make_unique<ChaseLevDeque<T>>());
+   }
+
+   bool push(Benchmark::Tid tid, T* t) noexcept
+   {
+      return m_deques[tid]->push(t);
+   }
+
+   T* pop(Benchmark::Tid tid) noexcept
+   {
+      return m_deques[tid]->pop();
+   }
+
+   // one round over random victims
+   T* steal(Benchmark::Tid tid, Benchmark::Random& rand) noexcept
+   {
+      auto n = unsigned(m_deques.size());
+      if (n < 2)
+         return nullptr;
+
+      auto start = rand(n - 1);
+      for (unsigned i = 0; i < n; ++i)
+      {
+         auto victim = (start + i) % n;
+         if (victim == tid)
+            continue;
+
+         if (auto t = m_deques[victim]->steal())
+            return t;
+      }
+
+      return nullptr;
+   }
+
+private:
+   std::vector<std::unique_ptr<ChaseLevDeque<T>>> m_deques;
+};
+
+
+//
+// tasks live in their spawner's frame, which waits for them
+//
+
+template <template <class> class Queue>
+class Worker;
+
+template <template <class> class Queue>
+struct Task
+{
+   void (*fn)(Task&, Worker<Queue>&) = nullptr;
+   std::atomic<std::uint32_t>* pending = nullptr;
+};
+
+
+struct alignas(64) WorkerStats
+{
+   std::uint64_t tasks = 0;
+   std::uint64_t steals = 0;
+   std::uint64_t idleNs = 0;
+};
+
+
+template <template <class> class Queue>
+class Worker final
+{
+public:
+   using Pool = Queue<Task<Queue>>;
+
+   Worker(Pool& pool, Benchmark::Tid tid, WorkerStats& stats) noexcept
+      : m_pool(pool)
+      , m_tid(tid)
+      , m_stats(stats)
+      , m_rand(tid + 1)
+   {}
+
+   void spawn(Task<Queue>& t)
+   {
+      if (!m_pool.push(m_tid, &t))
+         execute(t);
+   }
+
+   // runs queued tasks until pending drops to zero
+   void wait(std::atomic<std::uint32_t>& pending)
+   {
+      std::uint64_t idleSince = 0;
+
+      while (pending.load(std::memory_order_acquire))
+      {
+         auto t = m_pool.pop(m_tid);
+         if (!t && (t = m_pool.steal(m_tid, m_rand)))
+            ++m_stats.steals;
+
+         if (t)
+         {
+            if (idleSince)
+            {
+               m_stats.idleNs += now() - idleSince;
+               idleSince = 0;
+            }
+
+            execute(*t);
+            continue;
+         }
+
+         if (!idleSince)
+            idleSince = now();
+
+         std::this_thread::yield();
+      }
+
+      if (idleSince)
+         m_stats.idleNs += now() - idleSince;
+   }
+
+private:
+   // the task's frame may be gone once pending is decremented
+   void execute(Task<Queue>& t)
+   {
+      auto pending = t.pending;
+      t.fn(t, *this);
+      ++m_stats.tasks;
+      pending->fetch_sub(1, std::memory_order_release);
+   }
+
+   std::uint64_t now() noexcept
+   {
+      return std::uint64_t(m_clock().count());
+   }
+
+   Pool& m_pool;
+   Benchmark::Tid const m_tid;
+   WorkerStats& m_stats;
+   Benchmark::Random m_rand;
+   Benchmark::TimestampProvider m_clock;
+};
+
+
+// busy work of a given number of units
+inline Value spin(Value x, unsigned units) noexcept
+{
+   for (unsigned i = 0; i < units * 8; ++i)
+   {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+   }
+
+   return x;
+}
+
+
+//
+// workloads; each root() call is one job
+//
+
+// fib(n - 1) is spawned, fib(n - 2) computed inline
+struct Fib
+{
+   unsigned n;
+   unsigned cutoff;
+
+   template <template <class> class Queue>
+   struct FibTask
+      : public Task<Queue>
+   {
+      Fib const* fib;
+      unsigned n;
+      Value result;
+   };
+
+   static Value serial(unsigned n) noexcept
+   {
+      return n < 2 ? n : serial(n - 1) + serial(n - 2);
+   }
+
+   template <template <class> class Queue>
+   Value compute(Worker<Queue>& w, unsigned n) const
+   {
+      if (n < cutoff)
+         return serial(n);
+
+      std::atomic<std::uint32_t> pending = 1;
+
+      FibTask<Queue> child;
+      child.fn = [](Task<Queue>& t, Worker<Queue>& w)
+      {
+         auto& self = static_cast<FibTask<Queue>&>(t);
+         self.result = self.fib->compute(w, self.n);
+      };
+      child.pending = &pending;
+      child.fib = this;
+      child.n = n - 1;
+
+      w.spawn(child);
+      auto r = compute(w, n - 2);
+      w.wait(pending);
+
+      return r + child.result;
+   }
+
+   template <template <class> class Queue>
+   Value root(Worker<Queue>& w) const
+   {
+      return compute(w, n);
+   }
+};
+
+
+// recursive halving down to a grain; element costs vary 1-32x
+struct ParallelFor
+{
+   std::uint32_t size;
+   std::uint32_t grain;
+
+   template <template <class> class Queue>
+   struct RangeTask
+      : public Task<Queue>
+   {
+      ParallelFor const* loop;
+      std::uint32_t lo;
+      std::uint32_t hi;
+      Value result;
+   };
+
+   static unsigned cost(std::uint32_t i) noexcept
+   {
+      auto h = Value(i) * 0x9E3779B97F4A7C15ULL;
+      return 1 + unsigned(h >> 59);
+   }
+
+   template <template <class> class Queue>
+   Value range(Worker<Queue>& w, std::uint32_t lo, std::uint32_t hi) const
+   {
+      if (hi - lo <= grain)
+      {
+         Value r = 0;
+         for (auto i = lo; i < hi; ++i)
+            r += spin(i + 1, cost(i));
+
+         return r;
+      }
+
+      auto mid = lo + (hi - lo) / 2;
+      std::atomic<std::uint32_t> pending = 1;
+
+      RangeTask<Queue> right;
+      right.fn = [](Task<Queue>& t, Worker<Queue>& w)
+      {
+         auto& self = static_cast<RangeTask<Queue>&>(t);
+         self.result = self.loop->range(w, self.lo, self.hi);
+      };
+      right.pending = &pending;
+      right.loop = this;
+      right.lo = mid;
+      right.hi = hi;
+
+      w.spawn(right);
+      auto r = range(w, lo, mid);
+      w.wait(pending);
+
+      return r + right.result;
+   }
+
+   template <template <class> class Queue>
+   Value root(Worker<Queue>& w) const
+   {
+      return range(w, 0, size);
+   }
+};
+
+
+// levels of nodes where node (l, i) needs (l - 1, i) and (l - 1, i - 1);
+// a node spawns each successor it is the last dependency of
+struct Dag
+{
+   unsigned levels;
+   unsigned width;
+   unsigned units;
+
+   template <template <class> class Queue>
+   struct Node
+      : public Task<Queue>
+   {
+      Dag const* dag;
+      Node* nodes;
+      unsigned level;
+      unsigned index;
+      std::atomic<std::uint32_t> dependencies;
+      Value result;
+   };
+
+   template <template <class> class Queue>
+   Value root(Worker<Queue>& w) const
+   {
+      auto count = levels * width;
+      auto nodes = std::make_unique<Node<Queue>[]>(count);
+      std::atomic<std::uint32_t> pending = count;
+
+      for (unsigned l = 0; l < levels; ++l)
+      {
+         for (unsigned i = 0; i < width; ++i)
+         {
+            auto& n = nodes[l * width + i];
+            n.fn = run<Queue>;
+            n.pending = &pending;
+            n.dag = this;
+            n.nodes = nodes.get();
+            n.level = l;
+            n.index = i;
+            n.dependencies.store(l ? 2 : 0, std::memory_order_relaxed);
+         }
+      }
+
+      for (unsigned i = 0; i < width; ++i)
+         w.spawn(nodes[i]);
+
+      w.wait(pending);
+
+      Value r = 0;
+      for (unsigned i = 0; i < width; ++i)
+         r += nodes[(levels - 1) * width + i].result;
+
+      return r;
+   }
+
+   template <template <class> class Queue>
+   static void run(Task<Queue>& t, Worker<Queue>& w)
+   {
+      auto& self = static_cast<Node<Queue>&>(t);
+      auto const& dag = *self.dag;
+
+      self.result = spin(self.level * dag.width + self.index + 1, dag.units);
+
+      if (self.level + 1 == dag.levels)
+         return;
+
+      auto next = self.nodes + (self.level + 1) * dag.width;
+      for (auto i: { self.index, (self.index + 1) % dag.width })
+      {
+         if (next[i].dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            w.spawn(next[i]);
+      }
+   }
+};
+
+
+//
+// the fixture: every Runner thread is a worker
+//
+
+template <template <class> class Queue, class Workload>
+class Schedule final
+   : public Benchmark::Fixture
+{
+public:
+   Schedule(Workload workload) noexcept
+      : m_workload(workload)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      m_pool = std::make_unique<Queue<Task<Queue>>>(threads);
+      m_stats = std::vector<WorkerStats>(threads);
+      m_busy.store(threads, std::memory_order_relaxed);
+   }
+
+   void finalize() override
+   {
+      m_pool.reset();
+      m_stats.clear();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      Worker<Queue> w(*m_pool, tid, m_stats[tid]);
+
+      Value r = 0;
+      while (iterations--)
+         r += m_workload.root(w);
+
+      // keep helping until every worker is through its own jobs
+      m_busy.fetch_sub(1, std::memory_order_acq_rel);
+      w.wait(m_busy);
+
+      g_dontOptimize = r;
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      WorkerStats total;
+      for (auto const& s: m_stats)
+      {
+         total.tasks += s.tasks;
+         total.steals += s.steals;
+         total.idleNs += s.idleNs;
+      }
+
+      m.push_back({ "tasks/s", double(total.tasks), Benchmark::Metric::Kind::Rate });
+      m.push_back({ "steals", double(total.steals) });
+      m.push_back({
+         "ms idle/worker",
+         m_stats.empty() ? 0.0 : double(total.idleNs) / double(m_stats.size()) / 1e6
+      });
+   }
+
+private:
+   static inline volatile Value g_dontOptimize = 0;
+
+   Workload const m_workload;
+   std::unique_ptr<Queue<Task<Queue>>> m_pool;
+   std::vector<WorkerStats> m_stats;
+   std::atomic<std::uint32_t> m_busy = 0;
+};
+
+
+template <class Workload>
+void add(Benchmark::Runner& r, Workload const& workload)
+{
+   static std::vector<unsigned> const threads = { 1, 2, 4, 8 };
+
+   r.add(
+      "central queue",
+      Benchmark::Fixture::make<Schedule<CentralQueue, Workload>>(workload),
+      threads
+   );
+
+   r.add(
+      "work stealing (Chase-Lev)",
+      Benchmark::Fixture::make<Schedule<WorkStealing, Workload>>(workload),
+      threads
+   );
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t iterations = 20;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   {
+      Benchmark::Runner r("Recursive fib(25), cutoff 10", iterations);
+      add(r, Fib{ 25, 10 });
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Parallel for over 16K uneven elements, grain 64", iterations);
+      add(r, ParallelFor{ 1 << 14, 64 });
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("DAG of 32 levels x 64 nodes", iterations);
+      add(r, Dag{ 32, 64, 64 });
+      r.run();
+   }
+
+   return 0;
+}
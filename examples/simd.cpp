@@ -0,0 +1,921 @@
+//
+// data-parallel kernels, each as plain scalar code, as code the compiler
+// vectorizes (cloned per ISA and picked at load time), and hand-written
+// for SSE4.2, AVX2 and AVX-512 where the CPU has them
+//
+//    simd [-n <MB per row>]
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+   #define SIMD_X86 1
+   #include <immintrin.h>
+   #include <x86intrin.h>
+#else
+   #define SIMD_X86 0
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+   #define SIMD_SCALAR __attribute__((optimize("no-tree-vectorize")))
+#else
+   #define SIMD_SCALAR
+#endif
+
+#if SIMD_X86 && defined(__GNUC__) && BM_POSIX
+   #define SIMD_CLONES __attribute__((target_clones("default", "avx2", "avx512f")))
+#else
+   #define SIMD_CLONES
+#endif
+
+#define SIMD_SSE __attribute__((target("sse4.2,popcnt")))
+#define SIMD_AVX2 __attribute__((target("avx2,fma,popcnt")))
+#define SIMD_AVX512 __attribute__((target("avx512f,avx512bw,popcnt")))
+
+
+namespace
+{
+
+
+enum class Isa
+{
+   Scalar,
+   Auto,
+   Sse,
+   Avx2,
+   Avx512
+};
+
+bool supported(Isa isa) noexcept
+{
+   switch (isa)
+   {
+   case Isa::Scalar:
+   case Isa::Auto:
+      return true;
+
+#if SIMD_X86
+   case Isa::Sse:
+      return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+
+   case Isa::Avx2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+   case Isa::Avx512:
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+
+   default:
+      return false;
+   }
+}
+
+
+// TSC ticks, i.e. reference rather than core cycles; 0 if there is no TSC
+std::uint64_t cycles() noexcept
+{
+#if SIMD_X86
+   return __rdtsc();
+#else
+   return 0;
+#endif
+}
+
+
+//
+// sum of 32-bit integers, wrapping
+//
+
+struct SumData
+{
+   static constexpr std::size_t kElementBytes = sizeof(std::uint32_t);
+
+   SumData(std::size_t n)
+      : v(n)
+   {
+      Benchmark::Random r(1);
+      for (auto& x: v)
+         x = std::uint32_t(r());
+   }
+
+   std::vector<std::uint32_t> v;
+};
+
+SIMD_SCALAR double sumScalar(SumData& d)
+{
+   std::uint32_t s = 0;
+   for (auto x: d.v)
+      s += x;
+
+   return s;
+}
+
+SIMD_CLONES double sumAuto(SumData& d)
+{
+   std::uint32_t s = 0;
+   for (auto x: d.v)
+      s += x;
+
+   return s;
+}
+
+#if SIMD_X86
+
+SIMD_SSE double sumSse(SumData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   std::size_t i = 0;
+
+   auto a0 = _mm_setzero_si128();
+   auto a1 = _mm_setzero_si128();
+   for (; i + 8 <= n; i += 8)
+   {
+      a0 = _mm_add_epi32(a0, _mm_loadu_si128((__m128i const*)(p + i)));
+      a1 = _mm_add_epi32(a1, _mm_loadu_si128((__m128i const*)(p + i + 4)));
+   }
+
+   a0 = _mm_add_epi32(a0, a1);
+   a0 = _mm_add_epi32(a0, _mm_shuffle_epi32(a0, _MM_SHUFFLE(1, 0, 3, 2)));
+   a0 = _mm_add_epi32(a0, _mm_shuffle_epi32(a0, _MM_SHUFFLE(2, 3, 0, 1)));
+
+   auto s = std::uint32_t(_mm_cvtsi128_si32(a0));
+   for (; i < n; ++i)
+      s += p[i];
+
+   return s;
+}
+
+// the AVX-512 kernels add their two halves and finish here too, rather
+// than through _mm512_reduce_add_*, which GCC builds on an undefined
+// register and warns about; plain avx2, so it inlines into either
+__attribute__((target("avx2"))) std::uint32_t horizontalSum(__m256i a) noexcept
+{
+   auto h = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+   h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+   h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+
+   return std::uint32_t(_mm_cvtsi128_si32(h));
+}
+
+SIMD_AVX2 double sumAvx2(SumData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   std::size_t i = 0;
+
+   auto a0 = _mm256_setzero_si256();
+   auto a1 = _mm256_setzero_si256();
+   auto a2 = _mm256_setzero_si256();
+   auto a3 = _mm256_setzero_si256();
+   for (; i + 32 <= n; i += 32)
+   {
+      a0 = _mm256_add_epi32(a0, _mm256_loadu_si256((__m256i const*)(p + i)));
+      a1 = _mm256_add_epi32(a1, _mm256_loadu_si256((__m256i const*)(p + i + 8)));
+      a2 = _mm256_add_epi32(a2, _mm256_loadu_si256((__m256i const*)(p + i + 16)));
+      a3 = _mm256_add_epi32(a3, _mm256_loadu_si256((__m256i const*)(p + i + 24)));
+   }
+
+   a0 = _mm256_add_epi32(_mm256_add_epi32(a0, a1), _mm256_add_epi32(a2, a3));
+
+   auto s = horizontalSum(a0);
+   for (; i < n; ++i)
+      s += p[i];
+
+   return s;
+}
+
+SIMD_AVX512 double sumAvx512(SumData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   std::size_t i = 0;
+
+   auto a0 = _mm512_setzero_si512();
+   auto a1 = _mm512_setzero_si512();
+   auto a2 = _mm512_setzero_si512();
+   auto a3 = _mm512_setzero_si512();
+   for (; i + 64 <= n; i += 64)
+   {
+      a0 = _mm512_add_epi32(a0, _mm512_loadu_si512(p + i));
+      a1 = _mm512_add_epi32(a1, _mm512_loadu_si512(p + i + 16));
+      a2 = _mm512_add_epi32(a2, _mm512_loadu_si512(p + i + 32));
+      a3 = _mm512_add_epi32(a3, _mm512_loadu_si512(p + i + 48));
+   }
+
+   a0 = _mm512_add_epi32(_mm512_add_epi32(a0, a1), _mm512_add_epi32(a2, a3));
+
+   // the zero-masking extract, keeping every lane: GCC builds the
+   // plain one and the 512-to-256 cast on an undefined register too
+   auto low = _mm512_maskz_extracti64x4_epi64(0xFF, a0, 0);
+   auto high = _mm512_maskz_extracti64x4_epi64(0xFF, a0, 1);
+   auto s = horizontalSum(_mm256_add_epi32(low, high));
+   for (; i < n; ++i)
+      s += p[i];
+
+   return s;
+}
+
+#endif // SIMD_X86
+
+
+//
+// byte search: the index of the first needle, which is the last byte
+//
+
+struct SearchData
+{
+   static constexpr std::size_t kElementBytes = 1;
+   static constexpr std::uint8_t kNeedle = 0;
+
+   SearchData(std::size_t n)
+      : v(n)
+   {
+      Benchmark::Random r(1);
+      for (auto& x: v)
+         x = std::uint8_t(1 + r(254u));
+
+      v.back() = kNeedle;
+   }
+
+   std::vector<std::uint8_t> v;
+};
+
+SIMD_SCALAR double searchScalar(SearchData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   for (std::size_t i = 0; i < n; ++i)
+   {
+      if (p[i] == SearchData::kNeedle)
+         return double(i);
+   }
+
+   return double(n);
+}
+
+// compilers do not vectorize early exits, so test whole blocks first
+SIMD_CLONES double searchAuto(SearchData& d)
+{
+   constexpr std::size_t kBlock = 64;
+
+   auto p = d.v.data();
+   auto n = d.v.size();
+   std::size_t i = 0;
+   for (; i + kBlock <= n; i += kBlock)
+   {
+      std::uint8_t hit = 0;
+      for (std::size_t j = 0; j < kBlock; ++j)
+         hit |= (p[i + j] == SearchData::kNeedle);
+
+      if (hit)
+         break;
+   }
+
+   for (; i < n; ++i)
+   {
+      if (p[i] == SearchData::kNeedle)
+         return double(i);
+   }
+
+   return double(n);
+}
+
+double searchMemchr(SearchData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   auto hit = static_cast<std::uint8_t const*>(std::memchr(p, SearchData::kNeedle, n));
+   return double(hit ? std::size_t(hit - p) : n);
+}
+
+#if SIMD_X86
+
+SIMD_SSE double searchSse(SearchData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   auto needle = _mm_set1_epi8(char(SearchData::kNeedle));
+   std::size_t i = 0;
+
+   for (; i + 32 <= n; i += 32)
+   {
+      auto e0 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + i)), needle);
+      auto e1 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + i + 16)), needle);
+      auto m = unsigned(_mm_movemask_epi8(e0)) | (unsigned(_mm_movemask_epi8(e1)) << 16);
+      if (m)
+         return double(i + __builtin_ctz(m));
+   }
+
+   for (; i < n; ++i)
+   {
+      if (p[i] == SearchData::kNeedle)
+         return double(i);
+   }
+
+   return double(n);
+}
+
+SIMD_AVX2 double searchAvx2(SearchData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   auto needle = _mm256_set1_epi8(char(SearchData::kNeedle));
+   std::size_t i = 0;
+
+   for (; i + 64 <= n; i += 64)
+   {
+      auto e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const*)(p + i)), needle);
+      auto e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const*)(p + i + 32)), needle);
+      auto m = std::uint64_t(std::uint32_t(_mm256_movemask_epi8(e0))) |
+         (std::uint64_t(std::uint32_t(_mm256_movemask_epi8(e1))) << 32);
+
+      if (m)
+         return double(i + __builtin_ctzll(m));
+   }
+
+   for (; i < n; ++i)
+   {
+      if (p[i] == SearchData::kNeedle)
+         return double(i);
+   }
+
+   return double(n);
+}
+
+SIMD_AVX512 double searchAvx512(SearchData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   auto needle = _mm512_set1_epi8(char(SearchData::kNeedle));
+   std::size_t i = 0;
+
+   for (; i + 128 <= n; i += 128)
+   {
+      auto m0 = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p + i), needle);
+      auto m1 = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p + i + 64), needle);
+      if (m0 | m1)
+         return double(m0 ? i + __builtin_ctzll(m0) : i + 64 + __builtin_ctzll(m1));
+   }
+
+   for (; i < n; ++i)
+   {
+      if (p[i] == SearchData::kNeedle)
+         return double(i);
+   }
+
+   return double(n);
+}
+
+#endif // SIMD_X86
+
+
+//
+// filter: copy the values below a threshold, about half of them,
+// in random order
+//
+
+struct FilterData
+{
+   static constexpr std::size_t kElementBytes = sizeof(std::uint32_t);
+   static constexpr std::int32_t kThreshold = 1 << 30;
+
+   // vector stores may run a full register past the last kept value
+   FilterData(std::size_t n)
+      : v(n)
+      , out(n + 16)
+   {
+      Benchmark::Random r(1);
+      for (auto& x: v)
+         x = std::int32_t(r() >> 33);
+   }
+
+   std::vector<std::int32_t> v;
+   std::vector<std::int32_t> out;
+};
+
+SIMD_SCALAR double filterScalar(FilterData& d)
+{
+   auto out = d.out.data();
+   std::size_t k = 0;
+   for (auto x: d.v)
+   {
+      if (x < FilterData::kThreshold)
+         out[k++] = x;
+   }
+
+   return double(k);
+}
+
+// branch-free, but no compiler turns this into a vector compaction
+SIMD_CLONES double filterAuto(FilterData& d)
+{
+   auto out = d.out.data();
+   std::size_t k = 0;
+   for (auto x: d.v)
+   {
+      out[k] = x;
+      k += (x < FilterData::kThreshold);
+   }
+
+   return double(k);
+}
+
+#if SIMD_X86
+
+// shuffles moving the selected lanes to the front, per lane mask
+struct CompactTables
+{
+   alignas(16) std::uint8_t sse[16][16];
+   alignas(32) std::uint32_t avx2[256][8];
+};
+
+constexpr CompactTables makeCompactTables() noexcept
+{
+   CompactTables t{};
+
+   for (unsigned m = 0; m < 16; ++m)
+   {
+      unsigned k = 0;
+      for (unsigned lane = 0; lane < 4; ++lane)
+      {
+         if (m & (1u << lane))
+         {
+            for (unsigned b = 0; b < 4; ++b)
+               t.sse[m][k * 4 + b] = std::uint8_t(lane * 4 + b);
+
+            ++k;
+         }
+      }
+
+      for (; k < 4; ++k)
+      {
+         for (unsigned b = 0; b < 4; ++b)
+            t.sse[m][k * 4 + b] = 0x80;
+      }
+   }
+
+   for (unsigned m = 0; m < 256; ++m)
+   {
+      unsigned k = 0;
+      for (unsigned lane = 0; lane < 8; ++lane)
+      {
+         if (m & (1u << lane))
+            t.avx2[m][k++] = lane;
+      }
+   }
+
+   return t;
+}
+
+constexpr CompactTables kCompact = makeCompactTables();
+
+SIMD_SSE double filterSse(FilterData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   auto out = d.out.data();
+   auto threshold = _mm_set1_epi32(FilterData::kThreshold);
+   std::size_t i = 0;
+   std::size_t k = 0;
+
+   for (; i + 4 <= n; i += 4)
+   {
+      auto x = _mm_loadu_si128((__m128i const*)(p + i));
+      auto m = unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, threshold))));
+      auto shuffle = _mm_load_si128((__m128i const*)kCompact.sse[m]);
+      _mm_storeu_si128((__m128i*)(out + k), _mm_shuffle_epi8(x, shuffle));
+      k += __builtin_popcount(m);
+   }
+
+   for (; i < n; ++i)
+   {
+      out[k] = p[i];
+      k += (p[i] < FilterData::kThreshold);
+   }
+
+   return double(k);
+}
+
+SIMD_AVX2 double filterAvx2(FilterData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   auto out = d.out.data();
+   auto threshold = _mm256_set1_epi32(FilterData::kThreshold);
+   std::size_t i = 0;
+   std::size_t k = 0;
+
+   for (; i + 8 <= n; i += 8)
+   {
+      auto x = _mm256_loadu_si256((__m256i const*)(p + i));
+      auto m = unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(threshold, x))));
+      auto permutation = _mm256_load_si256((__m256i const*)kCompact.avx2[m]);
+      _mm256_storeu_si256((__m256i*)(out + k), _mm256_permutevar8x32_epi32(x, permutation));
+      k += __builtin_popcount(m);
+   }
+
+   for (; i < n; ++i)
+   {
+      out[k] = p[i];
+      k += (p[i] < FilterData::kThreshold);
+   }
+
+   return double(k);
+}
+
+SIMD_AVX512 double filterAvx512(FilterData& d)
+{
+   auto p = d.v.data();
+   auto n = d.v.size();
+   auto out = d.out.data();
+   auto threshold = _mm512_set1_epi32(FilterData::kThreshold);
+   std::size_t i = 0;
+   std::size_t k = 0;
+
+   for (; i + 16 <= n; i += 16)
+   {
+      auto x = _mm512_loadu_si512(p + i);
+      auto m = _mm512_cmplt_epi32_mask(x, threshold);
+      _mm512_mask_compressstoreu_epi32(out + k, m, x);
+      k += __builtin_popcount(m);
+   }
+
+   for (; i < n; ++i)
+   {
+      out[k] = p[i];
+      k += (p[i] < FilterData::kThreshold);
+   }
+
+   return double(k);
+}
+
+#endif // SIMD_X86
+
+
+//
+// dot product of two float vectors; an element is a pair
+//
+
+struct DotData
+{
+   static constexpr std::size_t kElementBytes = 2 * sizeof(float);
+
+   DotData(std::size_t n)
+      : x(n)
+      , y(n)
+   {
+      Benchmark::Random r(1);
+      for (std::size_t i = 0; i < n; ++i)
+      {
+         x[i] = float(r.real());
+         y[i] = float(r.real());
+      }
+   }
+
+   std::vector<float> x;
+   std::vector<float> y;
+};
+
+SIMD_SCALAR double dotScalar(DotData& d)
+{
+   auto n = d.x.size();
+   float s = 0;
+   for (std::size_t i = 0; i < n; ++i)
+      s += d.x[i] * d.y[i];
+
+   return s;
+}
+
+// the float reduction may only be reordered with permission
+SIMD_CLONES double dotAuto(DotData& d)
+{
+   auto x = d.x.data();
+   auto y = d.y.data();
+   auto n = d.x.size();
+   float s = 0;
+
+#pragma omp simd reduction(+: s)
+   for (std::size_t i = 0; i < n; ++i)
+      s += x[i] * y[i];
+
+   return s;
+}
+
+#if SIMD_X86
+
+SIMD_SSE double dotSse(DotData& d)
+{
+   auto x = d.x.data();
+   auto y = d.y.data();
+   auto n = d.x.size();
+   std::size_t i = 0;
+
+   auto a0 = _mm_setzero_ps();
+   auto a1 = _mm_setzero_ps();
+   for (; i + 8 <= n; i += 8)
+   {
+      a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+      a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+   }
+
+   a0 = _mm_add_ps(a0, a1);
+   a0 = _mm_add_ps(a0, _mm_movehl_ps(a0, a0));
+   a0 = _mm_add_ss(a0, _mm_shuffle_ps(a0, a0, 1));
+
+   auto s = _mm_cvtss_f32(a0);
+   for (; i < n; ++i)
+      s += x[i] * y[i];
+
+   return s;
+}
+
+__attribute__((target("avx2"))) float horizontalSum(__m256 a) noexcept
+{
+   auto h = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+   h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+   h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+
+   return _mm_cvtss_f32(h);
+}
+
+SIMD_AVX2 double dotAvx2(DotData& d)
+{
+   auto x = d.x.data();
+   auto y = d.y.data();
+   auto n = d.x.size();
+   std::size_t i = 0;
+
+   auto a0 = _mm256_setzero_ps();
+   auto a1 = _mm256_setzero_ps();
+   auto a2 = _mm256_setzero_ps();
+   auto a3 = _mm256_setzero_ps();
+   for (; i + 32 <= n; i += 32)
+   {
+      a0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), a0);
+      a1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), a1);
+      a2 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 16), _mm256_loadu_ps(y + i + 16), a2);
+      a3 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 24), _mm256_loadu_ps(y + i + 24), a3);
+   }
+
+   a0 = _mm256_add_ps(_mm256_add_ps(a0, a1), _mm256_add_ps(a2, a3));
+
+   auto s = horizontalSum(a0);
+   for (; i < n; ++i)
+      s += x[i] * y[i];
+
+   return s;
+}
+
+SIMD_AVX512 double dotAvx512(DotData& d)
+{
+   auto x = d.x.data();
+   auto y = d.y.data();
+   auto n = d.x.size();
+   std::size_t i = 0;
+
+   auto a0 = _mm512_setzero_ps();
+   auto a1 = _mm512_setzero_ps();
+   auto a2 = _mm512_setzero_ps();
+   auto a3 = _mm512_setzero_ps();
+   for (; i + 64 <= n; i += 64)
+   {
+      a0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), a0);
+      a1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16), a1);
+      a2 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 32), _mm512_loadu_ps(y + i + 32), a2);
+      a3 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 48), _mm512_loadu_ps(y + i + 48), a3);
+   }
+
+   a0 = _mm512_add_ps(_mm512_add_ps(a0, a1), _mm512_add_ps(a2, a3));
+
+   auto low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(a0), 0));
+   auto high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(a0), 1));
+   auto s = horizontalSum(_mm256_add_ps(low, high));
+   for (; i < n; ++i)
+      s += x[i] * y[i];
+
+   return s;
+}
+
+#endif // SIMD_X86
+
+
+//
+// harness glue
+//
+
+template <class Data>
+using KernelFn = double (*)(Data&);
+
+template <class Data>
+struct Variant
+{
+   char const* name;
+   Isa isa;
+   KernelFn<Data> fn;
+};
+
+
+// every iteration is one pass over the data
+template <class Data>
+class Kernel final
+   : public Benchmark::Fixture
+{
+public:
+   Kernel(std::size_t bytes, KernelFn<Data> fn) noexcept
+      : m_bytes(bytes)
+      , m_fn(fn)
+   {}
+
+   void initialize(unsigned) override
+   {
+      m_data = std::make_unique<Data>(elements());
+      m_passes = 0;
+      m_cycles = 0;
+   }
+
+   void finalize() override
+   {
+      m_data.reset();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto started = cycles();
+
+      double result = 0;
+      for (auto i = iterations; i; --i)
+         result += m_fn(*m_data);
+
+      m_cycles = cycles() - started;
+      m_passes = iterations;
+      g_dontOptimize = result;
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({
+         "GB/s",
+         double(m_passes) * double(elements() * Data::kElementBytes) / 1e9,
+         Benchmark::Metric::Kind::Rate
+      });
+
+      if (m_cycles)
+      {
+         m.push_back({
+            "elements/cycle",
+            double(m_passes) * double(elements()) / double(m_cycles)
+         });
+      }
+   }
+
+private:
+   std::size_t elements() const noexcept
+   {
+      return std::max<std::size_t>(1, m_bytes / Data::kElementBytes);
+   }
+
+   static volatile double g_dontOptimize;
+
+   std::size_t const m_bytes;
+   KernelFn<Data> const m_fn;
+   std::unique_ptr<Data> m_data;
+   std::uint64_t m_passes = 0;
+   std::uint64_t m_cycles = 0;
+};
+
+template <class Data>
+volatile double Kernel<Data>::g_dontOptimize = 0;
+
+
+struct Size
+{
+   std::size_t bytes;
+   char const* name;
+};
+
+constexpr Size kSizes[] = {
+   { std::size_t{16} << 10, "16 KiB (L1)" },
+   { std::size_t{256} << 10, "256 KiB (L2)" },
+   { std::size_t{4} << 20, "4 MiB (L3)" },
+   { std::size_t{64} << 20, "64 MiB (DRAM)" },
+};
+
+
+// one table per size; every row processes about the same number of bytes
+template <class Data>
+void runKernel(
+   char const* kernel,
+   std::initializer_list<Variant<Data>> variants,
+   std::uint64_t bytesPerRow
+)
+{
+   for (auto const& size: kSizes)
+   {
+      Benchmark::Runner r(
+         std::string(kernel) + ", " + size.name,
+         std::max<std::uint64_t>(1, bytesPerRow / size.bytes)
+      );
+
+      for (auto const& v: variants)
+      {
+         if (supported(v.isa))
+            r.add(v.name, Benchmark::Fixture::make<Kernel<Data>>(size.bytes, v.fn));
+      }
+
+      r.run();
+   }
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t megabytes = 1024;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      megabytes,
+      "-n must be a positive integer"
+   );
+
+   auto const bytesPerRow = megabytes << 20;
+
+   runKernel<SumData>(
+      "Sum of uint32",
+      {
+         { "scalar", Isa::Scalar, sumScalar },
+         { "auto-vectorized", Isa::Auto, sumAuto },
+#if SIMD_X86
+         { "SSE4.2", Isa::Sse, sumSse },
+         { "AVX2", Isa::Avx2, sumAvx2 },
+         { "AVX-512", Isa::Avx512, sumAvx512 },
+#endif
+      },
+      bytesPerRow
+   );
+
+   runKernel<SearchData>(
+      "Byte search",
+      {
+         { "scalar", Isa::Scalar, searchScalar },
+         { "auto-vectorized, blocks of 64", Isa::Auto, searchAuto },
+         { "memchr", Isa::Scalar, searchMemchr },
+#if SIMD_X86
+         { "SSE4.2", Isa::Sse, searchSse },
+         { "AVX2", Isa::Avx2, searchAvx2 },
+         { "AVX-512", Isa::Avx512, searchAvx512 },
+#endif
+      },
+      bytesPerRow
+   );
+
+   runKernel<FilterData>(
+      "Filter of int32, 50% selected",
+      {
+         { "scalar, branchy", Isa::Scalar, filterScalar },
+         { "scalar, branch-free", Isa::Auto, filterAuto },
+#if SIMD_X86
+         { "SSE4.2, shuffle table", Isa::Sse, filterSse },
+         { "AVX2, permute table", Isa::Avx2, filterAvx2 },
+         { "AVX-512, compress", Isa::Avx512, filterAvx512 },
+#endif
+      },
+      bytesPerRow
+   );
+
+   runKernel<DotData>(
+      "Dot product of float",
+      {
+         { "scalar", Isa::Scalar, dotScalar },
+         { "auto-vectorized", Isa::Auto, dotAuto },
+#if SIMD_X86
+         { "SSE4.2", Isa::Sse, dotSse },
+         { "AVX2 + FMA", Isa::Avx2, dotAvx2 },
+         { "AVX-512", Isa::Avx512, dotAvx512 },
+#endif
+      },
+      bytesPerRow
+   );
+
+   return 0;
+}
@@ -0,0 +1,680 @@
+//
+// sorting uint32 keys: std::sort, std::stable_sort, a pattern-defeating
+// quicksort, LSD radix sort, and sorting-network leaves merged bottom-up,
+// over several key distributions; small arrays are sorted in batches
+//
+//    sorting [-n <elements per row>] [-m <max elements>]
+//
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/allocstats.hpp"
+#include "benchmark/random.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/stopwatch.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+
+BM_COUNT_ALLOCATIONS()
+
+
+namespace
+{
+
+
+using Key = std::uint32_t;
+
+
+//
+// pdqsort (Orson Peters): introsort that picks pivots by median of 3
+// or ninther, puts runs of keys equal to the pivot aside, shuffles on
+// unbalanced partitions, finishes nearly sorted ranges by insertion
+// sort, and falls back to heapsort when partitions keep going bad
+//
+namespace Pdq
+{
+
+constexpr std::ptrdiff_t kInsertionSort = 24;
+constexpr std::ptrdiff_t kNinther = 128;
+constexpr std::ptrdiff_t kPartialInsertionLimit = 8;
+
+
+template <class It>
+void insertionSort(It b, It e)
+{
+   if (b == e)
+      return;
+
+   for (auto cur = b + 1; cur != e; ++cur)
+   {
+      auto sift = cur;
+      auto prev = cur - 1;
+      if (*sift < *prev)
+      {
+         auto tmp = std::move(*sift);
+         do
+         {
+            *sift-- = std::move(*prev);
+         } while (sift != b && tmp < *--prev);
+
+         *sift = std::move(tmp);
+      }
+   }
+}
+
+// gives up after moving too many keys
+template <class It>
+bool partialInsertionSort(It b, It e)
+{
+   if (b == e)
+      return true;
+
+   std::ptrdiff_t moved = 0;
+   for (auto cur = b + 1; cur != e; ++cur)
+   {
+      auto sift = cur;
+      auto prev = cur - 1;
+      if (*sift < *prev)
+      {
+         auto tmp = std::move(*sift);
+         do
+         {
+            *sift-- = std::move(*prev);
+         } while (sift != b && tmp < *--prev);
+
+         *sift = std::move(tmp);
+         moved += cur - sift;
+      }
+
+      if (moved > kPartialInsertionLimit)
+         return false;
+   }
+
+   return true;
+}
+
+template <class It>
+void sort2(It a, It b)
+{
+   if (*b < *a)
+      std::iter_swap(a, b);
+}
+
+template <class It>
+void sort3(It a, It b, It c)
+{
+   sort2(a, b);
+   sort2(b, c);
+   sort2(a, b);
+}
+
+// keys < pivot go left; the pivot is at *b, and the median selection
+// guarantees a key >= pivot at the end; returns the pivot position and
+// whether the range was already partitioned
+template <class It>
+std::pair<It, bool> partitionRight(It b, It e)
+{
+   auto pivot = std::move(*b);
+   auto first = b;
+   auto last = e;
+
+   while (*++first < pivot)
+      ;
+
+   if (first - 1 == b)
+   {
+      while (first < last && !(*--last < pivot))
+         ;
+   }
+   else
+   {
+      while (!(*--last < pivot))
+         ;
+   }
+
+   bool const partitioned = first >= last;
+
+   while (first < last)
+   {
+      std::iter_swap(first, last);
+      while (*++first < pivot)
+         ;
+      while (!(*--last < pivot))
+         ;
+   }
+
+   auto pivotPos = first - 1;
+   *b = std::move(*pivotPos);
+   *pivotPos = std::move(pivot);
+   return { pivotPos, partitioned };
+}
+
+// keys <= pivot go left; used when the pivot equals the key before the
+// range, so the left side holds only keys equal to it
+template <class It>
+It partitionLeft(It b, It e)
+{
+   auto pivot = std::move(*b);
+   auto first = b;
+   auto last = e;
+
+   while (pivot < *--last)
+      ;
+
+   if (last + 1 == e)
+   {
+      while (first < last && !(pivot < *++first))
+         ;
+   }
+   else
+   {
+      while (!(pivot < *++first))
+         ;
+   }
+
+   while (first < last)
+   {
+      std::iter_swap(first, last);
+      while (pivot < *--last)
+         ;
+      while (!(pivot < *++first))
+         ;
+   }
+
+   auto pivotPos = last;
+   *b = std::move(*pivotPos);
+   *pivotPos = std::move(pivot);
+   return pivotPos;
+}
+
+template <class It>
+void loop(It b, It e, int badAllowed, bool leftmost)
+{
+   for (;;)
+   {
+      auto size = e - b;
+      if (size < kInsertionSort)
+      {
+         insertionSort(b, e);
+         return;
+      }
+
+      auto half = size / 2;
+      if (size > kNinther)
+      {
+         sort3(b, b + half, e - 1);
+         sort3(b + 1, b + (half - 1), e - 2);
+         sort3(b + 2, b + (half + 1), e - 3);
+         sort3(b + (half - 1), b + half, b + (half + 1));
+         std::iter_swap(b, b + half);
+      }
+      else
+      {
+         sort3(b + half, b, e - 1);
+      }
+
+      // the key before us is a pivot of an earlier partition and equals ours
+      if (!leftmost && !(*(b - 1) < *b))
+      {
+         b = partitionLeft(b, e) + 1;
+         continue;
+      }
+
+      auto [pivotPos, partitioned] = partitionRight(b, e);
+      auto left = pivotPos - b;
+      auto right = e - (pivotPos + 1);
+
+      if (left < size / 8 || right < size / 8)
+      {
+         if (--badAllowed == 0)
+         {
+            std::make_heap(b, e);
+            std::sort_heap(b, e);
+            return;
+         }
+
+         // break up patterns that made the pivot choice fail
+         if (left >= kInsertionSort)
+         {
+            std::iter_swap(b, b + left / 4);
+            std::iter_swap(pivotPos - 1, pivotPos - left / 4);
+            if (left > kNinther)
+            {
+               std::iter_swap(b + 1, b + (left / 4 + 1));
+               std::iter_swap(b + 2, b + (left / 4 + 2));
+               std::iter_swap(pivotPos - 2, pivotPos - (left / 4 + 1));
+               std::iter_swap(pivotPos - 3, pivotPos - (left / 4 + 2));
+            }
+         }
+
+         if (right >= kInsertionSort)
+         {
+            std::iter_swap(pivotPos + 1, pivotPos + (1 + right / 4));
+            std::iter_swap(e - 1, e - right / 4);
+            if (right > kNinther)
+            {
+               std::iter_swap(pivotPos + 2, pivotPos + (2 + right / 4));
+               std::iter_swap(pivotPos + 3, pivotPos + (3 + right / 4));
+               std::iter_swap(e - 2, e - (1 + right / 4));
+               std::iter_swap(e - 3, e - (2 + right / 4));
+            }
+         }
+      }
+      else if (
+         partitioned &&
+         partialInsertionSort(b, pivotPos) &&
+         partialInsertionSort(pivotPos + 1, e)
+      )
+      {
+         return;
+      }
+
+      loop(b, pivotPos, badAllowed, leftmost);
+      b = pivotPos + 1;
+      leftmost = false;
+   }
+}
+
+template <class It>
+void sort(It b, It e)
+{
+   if (e - b > 1)
+      loop(b, e, std::bit_width(std::size_t(e - b)), true);
+}
+
+} // namespace Pdq
+
+
+// least significant byte first; passes where every key has the same
+// byte are skipped
+void radixSort(Key* b, Key* e)
+{
+   auto n = std::size_t(e - b);
+   if (n < 2)
+      return;
+
+   std::size_t counts[4][256] = {};
+   for (auto p = b; p != e; ++p)
+   {
+      for (unsigned d = 0; d < 4; ++d)
+         ++counts[d][(*p >> (8 * d)) & 0xFF];
+   }
+
+   std::vector<Key> buffer(n);
+   auto src = b;
+   auto dst = buffer.data();
+
+   for (unsigned d = 0; d < 4; ++d)
+   {
+      auto shift = 8 * d;
+      auto& count = counts[d];
+      if (count[(*src >> shift) & 0xFF] == n)
+         continue;
+
+      std::size_t offsets[256];
+      std::size_t sum = 0;
+      for (unsigned i = 0; i < 256; ++i)
+      {
+         offsets[i] = sum;
+         sum += count[i];
+      }
+
+      for (auto p = src; p != src + n; ++p)
+         dst[offsets[(*p >> shift) & 0xFF]++] = *p;
+
+      std::swap(src, dst);
+   }
+
+   if (src != b)
+      std::memcpy(b, src, n * sizeof(Key));
+}
+
+
+//
+// a 16-key Batcher odd-even merge network: branch-free compare-exchange
+// steps with no data-dependent control flow
+//
+
+constexpr unsigned kNetworkSize = 16;
+
+struct Comparator
+{
+   std::uint8_t a;
+   std::uint8_t b;
+};
+
+constexpr auto makeNetwork()
+{
+   std::array<Comparator, 63> net{};
+   std::size_t k = 0;
+
+   constexpr unsigned n = kNetworkSize;
+   for (unsigned p = 1; p < n; p <<= 1)
+   {
+      for (unsigned step = p; step >= 1; step >>= 1)
+      {
+         for (unsigned j = step % p; j + step < n; j += 2 * step)
+         {
+            for (unsigned i = 0; i < step && i + j + step < n; ++i)
+            {
+               if ((i + j) / (2 * p) == (i + j + step) / (2 * p))
+                  net[k++] = { std::uint8_t(i + j), std::uint8_t(i + j + step) };
+            }
+         }
+      }
+   }
+
+   return net;
+}
+
+constexpr auto kNetwork = makeNetwork();
+
+inline void network16(Key* v) noexcept
+{
+   for (auto c: kNetwork)
+   {
+      auto x = v[c.a];
+      auto y = v[c.b];
+      v[c.a] = std::min(x, y);
+      v[c.b] = std::max(x, y);
+   }
+}
+
+// the network on blocks of 16 (the last one padded), then merge passes
+void networkMergeSort(Key* b, Key* e)
+{
+   auto n = std::size_t(e - b);
+
+   for (std::size_t lo = 0; lo < n; lo += kNetworkSize)
+   {
+      auto len = std::min<std::size_t>(kNetworkSize, n - lo);
+      if (len == kNetworkSize)
+      {
+         network16(b + lo);
+         continue;
+      }
+
+      Key block[kNetworkSize];
+      std::fill(std::begin(block), std::end(block), std::numeric_limits<Key>::max());
+      std::copy(b + lo, b + lo + len, block);
+      network16(block);
+      std::copy(block, block + len, b + lo);
+   }
+
+   if (n <= kNetworkSize)
+      return;
+
+   std::vector<Key> buffer(n);
+   auto src = b;
+   auto dst = buffer.data();
+   for (std::size_t width = kNetworkSize; width < n; width *= 2)
+   {
+      for (std::size_t lo = 0; lo < n; lo += 2 * width)
+      {
+         auto mid = std::min(lo + width, n);
+         auto hi = std::min(lo + 2 * width, n);
+         std::merge(src + lo, src + mid, src + mid, src + hi, dst + lo);
+      }
+
+      std::swap(src, dst);
+   }
+
+   if (src != b)
+      std::memcpy(b, src, n * sizeof(Key));
+}
+
+
+using SortFn = void (*)(Key*, Key*);
+
+void stdSort(Key* b, Key* e)
+{
+   std::sort(b, e);
+}
+
+void stdStableSort(Key* b, Key* e)
+{
+   std::stable_sort(b, e);
+}
+
+void pdqSort(Key* b, Key* e)
+{
+   Pdq::sort(b, e);
+}
+
+
+//
+// inputs
+//
+
+enum class Distribution
+{
+   Sorted,
+   Reverse,
+   FewUnique,
+   Zipf,
+   Uniform
+};
+
+char const* distributionName(Distribution d) noexcept
+{
+   switch (d)
+   {
+   case Distribution::Sorted: return "sorted";
+   case Distribution::Reverse: return "reverse sorted";
+   case Distribution::FewUnique: return "16 unique keys";
+   case Distribution::Zipf: return "Zipf";
+   default: return "uniform random";
+   }
+}
+
+void generate(Key* b, Key* e, Distribution d, Benchmark::Random& r)
+{
+   auto n = std::uint64_t(e - b);
+
+   switch (d)
+   {
+   case Distribution::FewUnique:
+      for (auto p = b; p != e; ++p)
+         *p = Key(r(15u)) * 0x10001u;
+      break;
+
+   case Distribution::Zipf:
+      {
+         // ranks scattered over the key space, rank 0 the most frequent
+         Benchmark::Zipf zipf(std::max<std::uint64_t>(n, 2));
+         for (auto p = b; p != e; ++p)
+            *p = Key((zipf(r) + 1) * 0x9E3779B1u);
+      }
+      break;
+
+   default:
+      for (auto p = b; p != e; ++p)
+         *p = Key(r());
+      break;
+   }
+
+   if (d == Distribution::Sorted)
+      std::sort(b, e);
+   else if (d == Distribution::Reverse)
+      std::sort(b, e, [](Key x, Key y) { return y < x; });
+}
+
+
+// an iteration sorts a batch of independent arrays; only the sorting
+// is timed, not restoring the input
+class Sorting final
+   : public Benchmark::Fixture
+{
+public:
+   static constexpr std::size_t kBatchElements = 4096;
+
+   Sorting(SortFn fn, Distribution d, std::size_t size) noexcept
+      : m_fn(fn)
+      , m_distribution(d)
+      , m_size(size)
+      , m_arrays(std::max<std::size_t>(1, kBatchElements / size))
+   {}
+
+   void initialize(unsigned) override
+   {
+      Benchmark::Random r(1);
+      m_input.resize(m_arrays * m_size);
+      for (std::size_t i = 0; i < m_arrays; ++i)
+         generate(m_input.data() + i * m_size, m_input.data() + (i + 1) * m_size, m_distribution, r);
+
+      m_work.resize(m_input.size());
+      m_sortNs = 0;
+      m_elements = 0;
+
+      // the extra heap from one untimed pass, so the timed sorts
+      // allocate without the accounting
+      std::memcpy(m_work.data(), m_input.data(), m_work.size() * sizeof(Key));
+
+      Benchmark::AllocStats::Scope counting;
+      auto baseline = Benchmark::AllocStats::bytes;
+      Benchmark::AllocStats::peak = baseline;
+
+      for (std::size_t i = 0; i < m_arrays; ++i)
+         m_fn(m_work.data() + i * m_size, m_work.data() + (i + 1) * m_size);
+
+      m_overhead = Benchmark::AllocStats::peak - baseline;
+   }
+
+   void finalize() override
+   {
+      m_input = {};
+      m_work = {};
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      while (iterations--)
+      {
+         std::memcpy(m_work.data(), m_input.data(), m_work.size() * sizeof(Key));
+
+         Benchmark::Stopwatch<Benchmark::TimestampProvider> sw;
+         sw.start();
+
+         for (std::size_t i = 0; i < m_arrays; ++i)
+            m_fn(m_work.data() + i * m_size, m_work.data() + (i + 1) * m_size);
+
+         m_sortNs += std::uint64_t(sw.stop().count());
+         m_elements += m_work.size();
+      }
+
+      g_dontOptimize = m_work[m_size / 2];
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      m.push_back({ "ns/element", m_elements ? double(m_sortNs) / double(m_elements) : 0.0 });
+      m.push_back({ "B/element extra", double(m_overhead) / double(m_size) });
+   }
+
+private:
+   static inline volatile Key g_dontOptimize = 0;
+
+   SortFn const m_fn;
+   Distribution const m_distribution;
+   std::size_t const m_size;
+   std::size_t const m_arrays;
+   std::vector<Key> m_input;
+   std::vector<Key> m_work;
+   std::uint64_t m_sortNs = 0;
+   std::uint64_t m_elements = 0;
+   std::int64_t m_overhead = 0;
+};
+
+
+std::string sizeName(std::size_t n)
+{
+   if (n >= (1u << 20) && n % (1u << 20) == 0)
+      return std::to_string(n >> 20) + "M";
+
+   if (n >= (1u << 10) && n % (1u << 10) == 0)
+      return std::to_string(n >> 10) + "K";
+
+   return std::to_string(n);
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+
+   // only the untimed pass in Sorting::initialize() counts
+   Benchmark::AllocStats::enabled = false;
+
+   // elements sorted per row, which sets each table's iterations
+   std::uint64_t elements = 16ULL << 20;
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      elements,
+      "-n must be a positive integer"
+   );
+
+   // up to 100M with -m 100000000
+   std::uint64_t maxSize = 16ULL << 20;
+   Benchmark::bindArg(
+      cmd,
+      "-m",
+      maxSize,
+      "-m must be a positive integer"
+   );
+
+   std::vector<std::size_t> sizes;
+   for (std::size_t n = 16; n <= maxSize; n *= 16)
+      sizes.push_back(n);
+
+   if (maxSize >= 100000000ULL)
+      sizes.push_back(100000000ULL);
+
+   for (auto size: sizes)
+   {
+      for (auto d: {
+         Distribution::Sorted,
+         Distribution::Reverse,
+         Distribution::FewUnique,
+         Distribution::Zipf,
+         Distribution::Uniform
+      })
+      {
+         auto batch = std::max<std::size_t>(size, Sorting::kBatchElements);
+
+         Benchmark::Runner r(
+            sizeName(size) + " keys, " + distributionName(d),
+            std::max<std::uint64_t>(1, elements / batch)
+         );
+
+         r.add("std::sort", Benchmark::Fixture::make<Sorting>(stdSort, d, size));
+         r.add("std::stable_sort", Benchmark::Fixture::make<Sorting>(stdStableSort, d, size));
+         r.add("pdqsort", Benchmark::Fixture::make<Sorting>(pdqSort, d, size));
+         r.add("LSD radix sort", Benchmark::Fixture::make<Sorting>(radixSort, d, size));
+         r.add(
+            "16-key network + merge",
+            Benchmark::Fixture::make<Sorting>(networkMergeSort, d, size)
+         );
+
+         r.run();
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,395 @@
+//
+// system call and vDSO costs, including every clock the Stopwatch
+// providers read; clocks also report their resolution
+//
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/chrono.hpp"
+#include "benchmark/cputime.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+#if BM_POSIX
+   #include <fcntl.h>
+   #include <sched.h>
+   #include <sys/eventfd.h>
+   #include <sys/resource.h>
+   #include <sys/syscall.h>
+   #include <time.h>
+   #include <unistd.h>
+#endif
+
+
+namespace
+{
+
+
+class Fixture
+   : public Benchmark::Fixture
+{
+protected:
+   static volatile std::uint64_t g_dontOptimize;
+};
+
+volatile std::uint64_t Fixture::g_dontOptimize = 0;
+
+
+class GetPid final
+   : public Fixture
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      std::uint64_t sum = 0;
+      while (iterations--)
+         sum += std::uint64_t(::syscall(SYS_getpid));
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+};
+
+
+class SchedYield final
+   : public Fixture
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      while (iterations--)
+         ::sched_yield();
+
+      return 0;
+   }
+};
+
+
+class GetRusage final
+   : public Fixture
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      std::uint64_t sum = 0;
+      while (iterations--)
+      {
+         struct rusage ru = {};
+         ::getrusage(RUSAGE_THREAD, &ru);
+         sum += std::uint64_t(ru.ru_utime.tv_usec);
+      }
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+};
+
+
+class PipeRead final
+   : public Fixture
+{
+public:
+   void initialize(unsigned) override
+   {
+      [[maybe_unused]] auto r = ::pipe2(m_fds, O_CLOEXEC);
+   }
+
+   void finalize() override
+   {
+      ::close(m_fds[0]);
+      ::close(m_fds[1]);
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      char c;
+      std::uint64_t sum = 0;
+      while (iterations--)
+         sum += std::uint64_t(::read(m_fds[0], &c, 0));
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+
+private:
+   int m_fds[2] = { -1, -1 };
+};
+
+
+// a write() and the read() that drains it
+class EventFd final
+   : public Fixture
+{
+public:
+   void initialize(unsigned) override
+   {
+      m_fd = ::eventfd(0, EFD_CLOEXEC);
+   }
+
+   void finalize() override
+   {
+      ::close(m_fd);
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      std::uint64_t v = 1;
+      while (iterations--)
+      {
+         [[maybe_unused]] auto w = ::write(m_fd, &v, sizeof(v));
+         [[maybe_unused]] auto r = ::read(m_fd, &v, sizeof(v));
+      }
+
+      g_dontOptimize = v;
+      return 0;
+   }
+
+private:
+   int m_fd = -1;
+};
+
+
+//
+// clock reads; besides the cost, every clock reports the resolution
+// clock_getres() claims and the smallest step seen between two reads
+//
+
+class Clock
+   : public Fixture
+{
+public:
+   void initialize(unsigned) override
+   {
+      m_step = std::numeric_limits<std::uint64_t>::max();
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      if (m_resolution)
+         m.push_back({ "ns resolution", double(m_resolution) });
+
+      auto step = (m_step == std::numeric_limits<std::uint64_t>::max()) ? 0 : m_step;
+      m.push_back({ "ns smallest step", double(step) });
+   }
+
+protected:
+   void observe(std::uint64_t prev, std::uint64_t now) noexcept
+   {
+      if (now > prev && now - prev < m_step)
+         m_step = now - prev;
+   }
+
+   std::uint64_t m_resolution = 0;
+   std::uint64_t m_step = 0;
+};
+
+
+// clock_gettime() through the vDSO or, with Raw, as a real system call
+template <clockid_t Id, bool Raw = false>
+class ClockGettime final
+   : public Clock
+{
+public:
+   ClockGettime() noexcept
+   {
+      struct timespec res = {};
+      if (::clock_getres(Id, &res) == 0)
+         m_resolution = std::uint64_t(res.tv_sec) * 1000000000ULL + res.tv_nsec;
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      auto prev = read();
+      while (iterations--)
+      {
+         auto now = read();
+         observe(prev, now);
+         prev = now;
+      }
+
+      g_dontOptimize = prev;
+      return 0;
+   }
+
+private:
+   static std::uint64_t read() noexcept
+   {
+      struct timespec t = {};
+      if constexpr (Raw)
+         ::syscall(SYS_clock_gettime, Id, &t);
+      else
+         ::clock_gettime(Id, &t);
+
+      return std::uint64_t(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+   }
+};
+
+
+// the harness's own Stopwatch providers
+template <class Provider>
+class ProviderCall final
+   : public Clock
+{
+public:
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      Provider provider;
+
+      auto prev = toNs(provider());
+      while (iterations--)
+      {
+         auto now = toNs(provider());
+         observe(prev, now);
+         prev = now;
+      }
+
+      g_dontOptimize = prev;
+      return 0;
+   }
+
+private:
+   template <class Rep, class Period>
+   static std::uint64_t toNs(std::chrono::duration<Rep, Period> v) noexcept
+   {
+      return Benchmark::ns(v);
+   }
+
+   template <class Unit>
+   static std::uint64_t toNs(Benchmark::CpuUsage<Unit> const& v) noexcept
+   {
+      return Benchmark::ns(v.user + v.system);
+   }
+};
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t iterations = 1000000ULL;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   {
+      Benchmark::Runner r("System calls", iterations);
+
+      r.add("syscall(SYS_getpid)", Benchmark::Fixture::make<GetPid>());
+      r.add("getrusage(RUSAGE_THREAD)", Benchmark::Fixture::make<GetRusage>());
+      r.add("sched_yield()", Benchmark::Fixture::make<SchedYield>());
+      r.add("read() of 0 bytes from a pipe", Benchmark::Fixture::make<PipeRead>());
+      r.add("eventfd write() + read()", Benchmark::Fixture::make<EventFd>());
+
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Clocks", iterations);
+
+      r.add(
+         "clock_gettime(CLOCK_MONOTONIC_RAW)",
+         Benchmark::Fixture::make<ClockGettime<CLOCK_MONOTONIC_RAW>>()
+      );
+
+      r.add(
+         "clock_gettime(CLOCK_MONOTONIC)",
+         Benchmark::Fixture::make<ClockGettime<CLOCK_MONOTONIC>>()
+      );
+
+      r.add(
+         "clock_gettime(CLOCK_MONOTONIC), system call",
+         Benchmark::Fixture::make<ClockGettime<CLOCK_MONOTONIC, true>>()
+      );
+
+      r.add(
+         "clock_gettime(CLOCK_MONOTONIC_COARSE)",
+         Benchmark::Fixture::make<ClockGettime<CLOCK_MONOTONIC_COARSE>>()
+      );
+
+      r.add(
+         "clock_gettime(CLOCK_REALTIME)",
+         Benchmark::Fixture::make<ClockGettime<CLOCK_REALTIME>>()
+      );
+
+      r.add(
+         "clock_gettime(CLOCK_THREAD_CPUTIME_ID)",
+         Benchmark::Fixture::make<ClockGettime<CLOCK_THREAD_CPUTIME_ID>>()
+      );
+
+      r.add(
+         "clock_gettime(CLOCK_PROCESS_CPUTIME_ID)",
+         Benchmark::Fixture::make<ClockGettime<CLOCK_PROCESS_CPUTIME_ID>>()
+      );
+
+      r.run();
+   }
+
+   {
+      Benchmark::Runner r("Stopwatch providers", iterations);
+
+      r.add(
+         "TimestampProvider",
+         Benchmark::Fixture::make<ProviderCall<Benchmark::TimestampProvider>>()
+      );
+
+      r.add(
+         "DefaultTimestampProvider (steady_clock)",
+         Benchmark::Fixture::make<ProviderCall<Benchmark::DefaultTimestampProvider>>()
+      );
+
+      r.add(
+         "ThreadCpuTimeProvider",
+         Benchmark::Fixture::make<ProviderCall<Benchmark::ThreadCpuTimeProvider>>()
+      );
+
+      r.add(
+         "ProcessCpuTimeProvider",
+         Benchmark::Fixture::make<ProviderCall<Benchmark::ProcessCpuTimeProvider>>()
+      );
+
+      r.add(
+         "ThreadCpuUsageProvider",
+         Benchmark::Fixture::make<ProviderCall<Benchmark::ThreadCpuUsageProvider>>()
+      );
+
+      r.add(
+         "ProcessCpuUsageProvider",
+         Benchmark::Fixture::make<ProviderCall<Benchmark::ProcessCpuUsageProvider>>()
+      );
+
+      r.run();
+   }
+
+   return 0;
+}
@@ -1,9 +1,24 @@
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <exception>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __has_include(<expected>)
+   #include <expected>
+#endif
 
 #include "benchmark/benchmark.hpp"
+#include "benchmark/random.hpp"
 #include "benchmark/runner.hpp"
+#include "benchmark/util.hpp"
+
+#if BM_POSIX
+   #include <dlfcn.h>
+#endif
 
 
 namespace
@@ -136,14 +151,448 @@ private:
 thread_local long MaybeTryCatch::t_caught = 0;
 std::atomic<long> MaybeTryCatch::g_caught = 0;
 
+
+// throwDsoCall() of a throw_dso_* module, which throws and catches
+// inside the module for a negative argument
+using DsoCall = int (*)(int);
+
+
+// every iteration throws at throwAtDepth, or inside a module if one is
+// given; reports the throw rate of all the threads together, then per
+// thread
+class ThrowScaling
+   : public Fixture
+{
+public:
+   ThrowScaling(unsigned throwAtDepth, DsoCall dsoCall = nullptr)
+      : Fixture(throwAtDepth, throwAtDepth)
+      , m_dsoCall(dsoCall)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      m_threads = threads;
+      m_throws = 0;
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      long thrown = 0;
+      if (m_dsoCall)
+      {
+         while (iterations--)
+            thrown += (m_dsoCall(-1) < 0);
+      }
+      else
+      {
+         while (iterations--)
+         {
+            try
+            {
+               frame(0);
+            }
+            catch (Bang&)
+            {
+               ++thrown;
+            }
+         }
+      }
+
+      m_throws.fetch_add(thrown, std::memory_order_relaxed);
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      auto const throws = double(m_throws.load(std::memory_order_relaxed));
+
+      m.push_back({ "throws/s", throws, Benchmark::Metric::Kind::Rate });
+      m.push_back({
+         "throws/s per thread",
+         throws / m_threads,
+         Benchmark::Metric::Kind::Rate
+      });
+   }
+
+private:
+   DsoCall const m_dsoCall;
+   unsigned m_threads = 1;
+   std::atomic<long> m_throws = 0;
+};
+
+
+#if BM_POSIX
+
+// loads the throw_dso_* modules [from, to) built next to the
+// executable; returns the throwDsoCall() of the last one loaded, whose
+// FDEs the unwinder finds last, since it searches in load order
+DsoCall loadModules(unsigned from, unsigned to, unsigned& loaded)
+{
+   std::error_code ec;
+   auto dir = std::filesystem::read_symlink("/proc/self/exe", ec).parent_path();
+
+   DsoCall last = nullptr;
+   for (unsigned i = from; i < to; ++i)
+   {
+      auto path = dir / ("libthrow_dso_" + std::to_string(i) + ".so");
+      auto module = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+      if (!module)
+         continue;
+
+      if (auto call = reinterpret_cast<DsoCall>(::dlsym(module, "throwDsoCall")))
+      {
+         last = call;
+         ++loaded;
+      }
+   }
+
+   return last;
+}
+
+#endif // BM_POSIX
+
+
+void addThrowScaling(
+   Benchmark::Runner& r,
+   std::vector<unsigned> const& threads,
+   DsoCall dsoCall = nullptr
+)
+{
+   if (dsoCall)
+   {
+      r.add(
+         "throw inside the last module loaded",
+         Fixture::make<ThrowScaling>(1, dsoCall),
+         threads
+      );
+   }
+
+   r.add(
+      "throw at depth 1",
+      Fixture::make<ThrowScaling>(1),
+      threads
+   );
+
+   r.add(
+      "throw at depth 16",
+      Fixture::make<ThrowScaling>(16),
+      threads
+   );
+}
+
+
+//
+// error propagation alternatives: the deepest frame fails on
+// a given share of the calls, and every frame above it
+// passes the failure on
+//
+
+class Propagation
+   : public Fixture
+{
+public:
+   Propagation(unsigned depth, unsigned failurePercent)
+      : Fixture(depth, depth)
+      , m_failurePercent(failurePercent)
+   {}
+
+   void initialize(unsigned tid) override
+   {
+      // exactly failurePercent% of the pattern fails, in random order
+      auto const failures = kPattern * m_failurePercent / 100;
+      for (std::size_t i = 0; i < kPattern; ++i)
+         m_fails[i] = (i < failures);
+
+      Benchmark::Random r(tid + 1);
+      for (auto i = kPattern - 1; i > 0; --i)
+         std::swap(m_fails[i], m_fails[r(i)]);
+   }
+
+protected:
+   static constexpr std::size_t kPattern = 1024;
+
+   bool fails(Benchmark::Counter i) const noexcept
+   {
+      return m_fails[i & (kPattern - 1)];
+   }
+
+   static volatile unsigned g_dontOptimize;
+
+private:
+   unsigned const m_failurePercent;
+   std::array<bool, kPattern> m_fails = {};
+};
+
+volatile unsigned Propagation::g_dontOptimize = 0;
+
+
+class Exceptions
+   : public Propagation
+{
+public:
+   using Propagation::Propagation;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      unsigned sum = 0;
+      while (iterations--)
+      {
+         try
+         {
+            sum += frame(0, fails(iterations));
+         }
+         catch (Bang& e)
+         {
+            sum += e.level;
+         }
+      }
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+
+private:
+   BM_NOINLINE unsigned frame(unsigned level, bool fail)
+   {
+      Frame f;
+
+      if (level == m_maxDepth)
+      {
+         if (fail)
+            throw Bang(level);
+
+         return level;
+      }
+
+      return frame(level + 1, fail) + 1;
+   }
+};
+
+
+#if __cpp_lib_expected
+
+class Expected
+   : public Propagation
+{
+public:
+   using Propagation::Propagation;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      unsigned sum = 0;
+      while (iterations--)
+      {
+         auto r = frame(0, fails(iterations));
+         if (r)
+            sum += *r;
+         else
+            sum += r.error().level;
+      }
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+
+private:
+   struct Error
+   {
+      unsigned level;
+   };
+
+   BM_NOINLINE std::expected<unsigned, Error> frame(unsigned level, bool fail)
+   {
+      Frame f;
+
+      if (level == m_maxDepth)
+      {
+         if (fail)
+         {
+            ++t_banged;
+            return std::unexpected(Error{ level });
+         }
+
+         return level;
+      }
+
+      auto r = frame(level + 1, fail);
+      if (!r)
+         return r;
+
+      return *r + 1;
+   }
+};
+
+#endif // __cpp_lib_expected
+
+
+class ErrorCodes
+   : public Propagation
+{
+public:
+   using Propagation::Propagation;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      unsigned sum = 0;
+      while (iterations--)
+      {
+         unsigned v = 0;
+         if (frame(0, fails(iterations), v) == Errc::Ok)
+            sum += v;
+         else
+            sum += m_maxDepth;
+      }
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+
+private:
+   enum class Errc
+   {
+      Ok,
+      Failed
+   };
+
+   BM_NOINLINE Errc frame(unsigned level, bool fail, unsigned& out)
+   {
+      Frame f;
+
+      if (level == m_maxDepth)
+      {
+         if (fail)
+         {
+            ++t_banged;
+            return Errc::Failed;
+         }
+
+         out = level;
+         return Errc::Ok;
+      }
+
+      auto e = frame(level + 1, fail, out);
+      if (e != Errc::Ok)
+         return e;
+
+      ++out;
+      return Errc::Ok;
+   }
+};
+
+
+// a status object carrying a (heap allocated) message
+class StatusObjects
+   : public Propagation
+{
+public:
+   using Propagation::Propagation;
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid
+   ) override
+   {
+      unsigned sum = 0;
+      while (iterations--)
+      {
+         unsigned v = 0;
+         auto s = frame(0, fails(iterations), v);
+         if (s.ok())
+            sum += v;
+         else
+            sum += unsigned(s.message().size());
+      }
+
+      g_dontOptimize = sum;
+      return 0;
+   }
+
+private:
+   class Status final
+   {
+   public:
+      Status() noexcept = default;
+
+      Status(int code, std::string message)
+         : m_code(code)
+         , m_message(std::move(message))
+      {}
+
+      bool ok() const noexcept
+      {
+         return !m_code;
+      }
+
+      int code() const noexcept
+      {
+         return m_code;
+      }
+
+      std::string const& message() const noexcept
+      {
+         return m_message;
+      }
+
+   private:
+      int m_code = 0;
+      std::string m_message;
+   };
+
+   BM_NOINLINE Status frame(unsigned level, bool fail, unsigned& out)
+   {
+      Frame f;
+
+      if (level == m_maxDepth)
+      {
+         if (fail)
+         {
+            ++t_banged;
+            return Status(1, "failure at frame " + std::to_string(level));
+         }
+
+         out = level;
+         return {};
+      }
+
+      auto s = frame(level + 1, fail, out);
+      if (!s.ok())
+         return s;
+
+      ++out;
+      return {};
+   }
+};
+
 } // namespace
 
 
-int main()
+int main(int argc, char** argv)
 {
+   Benchmark::CmdLine cmd(argc, argv);
+
    constexpr unsigned maxDepth = 16;
 
-   constexpr std::uint64_t iterations = 100000ULL;
+   std::uint64_t iterations = 100000ULL;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
    Benchmark::Runner r("Exception performance", iterations);
 
    r.add(
@@ -165,5 +614,102 @@ int main()
 
    r.run();
 
+   // throw scaling: -t <max threads>, -m <extra modules to load>
+   unsigned maxThreads = 16;
+   Benchmark::bindArg(
+      cmd,
+      "-t",
+      maxThreads,
+      "-t must be a positive integer"
+   );
+
+   unsigned modules = 0;
+   Benchmark::bindArg(
+      cmd,
+      "-m",
+      modules,
+      "-m must be a number of modules"
+   );
+
+   std::vector<unsigned> threads;
+   for (unsigned t = 1; t < maxThreads; t *= 2)
+      threads.push_back(t);
+   threads.push_back(std::max(maxThreads, 1u));
+
+   {
+      Benchmark::Runner rs("Exception throw scaling", iterations);
+      addThrowScaling(rs, threads);
+      rs.run();
+   }
+
+#if BM_POSIX
+   // a throw from one module loaded, then from the last of many: the
+   // same code, with a longer search for its FDEs
+   if (modules)
+   {
+      unsigned loaded = 0;
+      auto first = loadModules(0, 1, loaded);
+      if (first)
+      {
+         Benchmark::Runner rs("Exception throw scaling, 1 more module loaded", iterations);
+         addThrowScaling(rs, threads, first);
+         rs.run();
+      }
+
+      auto last = loadModules(1, std::min(modules, unsigned(THROW_DSO_COUNT)), loaded);
+      if (last)
+      {
+         Benchmark::Runner rs(
+            "Exception throw scaling, " + std::to_string(loaded) + " more modules loaded",
+            iterations
+         );
+
+         addThrowScaling(rs, threads, last);
+         rs.run();
+      }
+   }
+#endif
+
+   // failure propagation: one table per depth
+   for (unsigned depth: { 4u, 16u, 64u })
+   {
+      Benchmark::Runner rp(
+         "Error propagation through " + std::to_string(depth) + " frames",
+         iterations
+      );
+
+      for (unsigned percent: { 0u, 1u, 10u, 50u, 100u })
+      {
+         auto name = [percent](char const* what)
+         {
+            return std::string(what) + ", " + std::to_string(percent) + "% fail";
+         };
+
+         rp.add(
+            name("exceptions"),
+            Fixture::make<Exceptions>(depth, percent)
+         );
+
+#if __cpp_lib_expected
+         rp.add(
+            name("std::expected"),
+            Fixture::make<Expected>(depth, percent)
+         );
+#endif
+
+         rp.add(
+            name("error codes"),
+            Fixture::make<ErrorCodes>(depth, percent)
+         );
+
+         rp.add(
+            name("status objects"),
+            Fixture::make<StatusObjects>(depth, percent)
+         );
+      }
+
+      rp.run();
+   }
+
    return 0;
 }
@@ -0,0 +1,35 @@
+//
+// one of THROW_DSO_COUNT otherwise identical modules throw -m loads
+// to grow the list of objects the unwinder searches for FDEs
+//
+
+#include <stdexcept>
+
+#include "benchmark/benchmark.hpp"
+
+
+namespace
+{
+
+BM_NOINLINE int twice(int x)
+{
+   if (x < 0)
+      throw std::invalid_argument("negative");
+
+   return x * 2;
+}
+
+} // namespace
+
+
+extern "C" BM_EXPORT int throwDsoCall(int x) noexcept
+{
+   try
+   {
+      return twice(x) + THROW_DSO_INDEX;
+   }
+   catch (std::exception const&)
+   {
+      return -1;
+   }
+}
@@ -0,0 +1,465 @@
+//
+// thread wake-up: threads 2k and 2k + 1 hand a turn back and forth;
+// every handoff records the time from the signal to the wake-up
+//
+
+#include <atomic>
+#include <barrier>
+#include <condition_variable>
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "benchmark/histogram.hpp"
+#include "benchmark/runner.hpp"
+#include "benchmark/timestamp.hpp"
+#include "benchmark/util.hpp"
+
+#if BM_POSIX
+   #include <fcntl.h>
+   #include <linux/futex.h>
+   #include <sys/eventfd.h>
+   #include <sys/syscall.h>
+   #include <unistd.h>
+#endif
+
+
+namespace
+{
+
+
+//
+// mechanisms: binary semaphores built on each primitive;
+// a post() before the matching wait() is not lost
+//
+
+class CondVar final
+{
+public:
+   void post()
+   {
+      {
+         std::lock_guard l(m_mutex);
+         m_signaled = true;
+      }
+
+      m_cv.notify_one();
+   }
+
+   void wait()
+   {
+      std::unique_lock l(m_mutex);
+      m_cv.wait(l, [this]() { return m_signaled; });
+      m_signaled = false;
+   }
+
+private:
+   std::mutex m_mutex;
+   std::condition_variable m_cv;
+   bool m_signaled = false;
+};
+
+
+class Semaphore final
+{
+public:
+   void post()
+   {
+      m_sem.release();
+   }
+
+   void wait()
+   {
+      m_sem.acquire();
+   }
+
+private:
+   std::counting_semaphore<> m_sem{ 0 };
+};
+
+
+// a latch is single-use, so posts alternate between two of them; the
+// waiter re-arms the one the previous post used, whose signaler is done
+// with it by now, having posted again since: re-arming the one just
+// waited on could destroy it while count_down() is still notifying
+class Latch final
+{
+public:
+   Latch()
+   {
+      for (auto i = 0; i < 2; ++i)
+         std::construct_at(latch(i), 1);
+   }
+
+   ~Latch()
+   {
+      for (auto i = 0; i < 2; ++i)
+         std::destroy_at(latch(i));
+   }
+
+   void post()
+   {
+      latch(m_posted)->count_down();
+      m_posted ^= 1;
+   }
+
+   void wait()
+   {
+      latch(m_waited)->wait();
+      m_waited ^= 1;
+
+      std::destroy_at(latch(m_waited));
+      std::construct_at(latch(m_waited), 1);
+   }
+
+private:
+   std::latch* latch(unsigned i) noexcept
+   {
+      return reinterpret_cast<std::latch*>(m_storage[i]);
+   }
+
+   // each used by one side only
+   unsigned m_posted = 0;
+   unsigned m_waited = 0;
+   alignas(std::latch) unsigned char m_storage[2][sizeof(std::latch)];
+};
+
+
+// the signaler and the waiter both arrive; the waiter waits for the phase
+class Barrier final
+{
+public:
+   void post()
+   {
+      [[maybe_unused]] auto token = m_barrier.arrive();
+   }
+
+   void wait()
+   {
+      m_barrier.arrive_and_wait();
+   }
+
+private:
+   std::barrier<> m_barrier{ 2 };
+};
+
+
+#if BM_POSIX
+
+class Futex final
+{
+public:
+   void post()
+   {
+      m_word.store(1, std::memory_order_release);
+      ::syscall(SYS_futex, &m_word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+   }
+
+   void wait()
+   {
+      while (m_word.exchange(0, std::memory_order_acquire) == 0)
+         ::syscall(SYS_futex, &m_word, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+   }
+
+private:
+   std::atomic<std::uint32_t> m_word = 0;
+};
+
+
+class EventFd final
+{
+public:
+   EventFd()
+      : m_fd(::eventfd(0, EFD_CLOEXEC))
+   {}
+
+   ~EventFd()
+   {
+      ::close(m_fd);
+   }
+
+   void post()
+   {
+      std::uint64_t one = 1;
+      [[maybe_unused]] auto r = ::write(m_fd, &one, sizeof(one));
+   }
+
+   void wait()
+   {
+      std::uint64_t v;
+      [[maybe_unused]] auto r = ::read(m_fd, &v, sizeof(v));
+   }
+
+private:
+   int m_fd;
+};
+
+
+class Pipe final
+{
+public:
+   Pipe()
+   {
+      [[maybe_unused]] auto r = ::pipe2(m_fds, O_CLOEXEC);
+   }
+
+   ~Pipe()
+   {
+      ::close(m_fds[0]);
+      ::close(m_fds[1]);
+   }
+
+   void post()
+   {
+      char c = 0;
+      [[maybe_unused]] auto r = ::write(m_fds[1], &c, 1);
+   }
+
+   void wait()
+   {
+      char c;
+      [[maybe_unused]] auto r = ::read(m_fds[0], &c, 1);
+   }
+
+private:
+   int m_fds[2] = { -1, -1 };
+};
+
+#endif // BM_POSIX
+
+
+//
+// one direction of a handoff; with spin > 0 the waiter spins that
+// many times before it parks in the mechanism, and the signaler only
+// goes through the mechanism for a parked waiter
+//
+template <class Mechanism>
+class Event final
+{
+public:
+   void signal(bool spinning) noexcept
+   {
+      m_sent.store(m_clock().count(), std::memory_order_relaxed);
+
+      if (!spinning)
+      {
+         m_mech.post();
+         return;
+      }
+
+      if (m_state.exchange(kSignaled, std::memory_order_acq_rel) == kParked)
+         m_mech.post();
+   }
+
+   // returns the signal-to-wake-up latency
+   std::uint64_t wait(unsigned spin) noexcept
+   {
+      if (!spin)
+      {
+         m_mech.wait();
+         return latency();
+      }
+
+      while (spin--)
+      {
+         if (m_state.load(std::memory_order_acquire) == kSignaled)
+         {
+            m_state.store(kEmpty, std::memory_order_relaxed);
+            return latency();
+         }
+
+         pause();
+      }
+
+      if (m_state.exchange(kParked, std::memory_order_acq_rel) != kSignaled)
+         m_mech.wait();
+
+      m_state.store(kEmpty, std::memory_order_relaxed);
+      return latency();
+   }
+
+private:
+   static constexpr std::uint32_t kEmpty = 0;
+   static constexpr std::uint32_t kSignaled = 1;
+   static constexpr std::uint32_t kParked = 2;
+
+   static void pause() noexcept
+   {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+   }
+
+   std::uint64_t latency() noexcept
+   {
+      auto now = std::uint64_t(m_clock().count());
+      auto sent = m_sent.load(std::memory_order_relaxed);
+      return now > sent ? now - sent : 0;
+   }
+
+   Benchmark::TimestampProvider m_clock;
+   std::atomic<std::uint32_t> m_state = kEmpty;
+   std::atomic<std::uint64_t> m_sent = 0;
+   Mechanism m_mech;
+};
+
+
+template <class Mechanism>
+class Handoff
+   : public Benchmark::Fixture
+{
+public:
+   Handoff(unsigned spin = 0) noexcept
+      : m_spin(spin)
+   {}
+
+   void initialize(unsigned threads) override
+   {
+      m_pairs.clear();
+      for (unsigned i = 0; i < threads / 2; ++i)
+         m_pairs.push_back(std::make_unique<Pair>());
+
+      m_latencies = std::vector<Benchmark::Histogram>(threads);
+      m_roundTrips = 0;
+   }
+
+   void finalize() override
+   {
+      m_pairs.clear();
+      m_latencies.clear();
+   }
+
+   Benchmark::Counter run(
+      Benchmark::Counter iterations,
+      Benchmark::Tid tid
+   ) override
+   {
+      // an unpaired thread has no one to wake
+      if (tid / 2 >= m_pairs.size())
+         return 0;
+
+      auto& pair = *m_pairs[tid / 2];
+      auto& latencies = m_latencies[tid];
+      bool const spinning = (m_spin > 0);
+
+      if (tid % 2 == 0)
+      {
+         for (auto i = iterations; i; --i)
+         {
+            pair.ping.signal(spinning);
+            latencies.record(pair.pong.wait(m_spin));
+         }
+
+         m_roundTrips.fetch_add(iterations, std::memory_order_relaxed);
+      }
+      else
+      {
+         for (auto i = iterations; i; --i)
+         {
+            latencies.record(pair.ping.wait(m_spin));
+            pair.pong.signal(spinning);
+         }
+      }
+
+      return 0;
+   }
+
+   void report(Benchmark::Metrics& m) override
+   {
+      Benchmark::Histogram all;
+      for (auto& h: m_latencies)
+         all.merge(h);
+
+      m.push_back({
+         "round trips/s",
+         double(m_roundTrips.load(std::memory_order_relaxed)),
+         Benchmark::Metric::Kind::Rate
+      });
+
+      all.report(m);
+   }
+
+private:
+   struct Pair
+   {
+      alignas(64) Event<Mechanism> ping;
+      alignas(64) Event<Mechanism> pong;
+   };
+
+   unsigned const m_spin;
+   std::vector<std::unique_ptr<Pair>> m_pairs;
+   std::vector<Benchmark::Histogram> m_latencies;
+   std::atomic<std::uint64_t> m_roundTrips = 0;
+};
+
+
+template <class Mechanism>
+void add(
+   Benchmark::Runner& r,
+   char const* name,
+   unsigned spin
+)
+{
+   r.add(
+      std::string(name) + (spin ? ", spin then park" : ", park"),
+      Benchmark::Fixture::make<Handoff<Mechanism>>(spin),
+      { 2, 4 }
+   );
+}
+
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+   Benchmark::CmdLine cmd(argc, argv);
+   std::uint64_t iterations = 50000ULL;
+
+   Benchmark::bindArg(
+      cmd,
+      "-n",
+      iterations,
+      "-n must be a positive integer"
+   );
+
+   // spin iterations before parking
+   unsigned spin = 4000;
+   Benchmark::bindArg(
+      cmd,
+      "-s",
+      spin,
+      "-s must be a non-negative integer"
+   );
+
+   for (auto s: { 0u, spin })
+   {
+      Benchmark::Runner r(
+         s ? "Thread wake-up, spin then park" : "Thread wake-up, park",
+         iterations
+      );
+
+      add<CondVar>(r, "std::condition_variable", s);
+#if BM_POSIX
+      add<Futex>(r, "futex", s);
+#endif
+      add<Semaphore>(r, "std::counting_semaphore", s);
+      add<Latch>(r, "std::latch", s);
+      add<Barrier>(r, "std::barrier", s);
+#if BM_POSIX
+      add<EventFd>(r, "eventfd", s);
+      add<Pipe>(r, "pipe", s);
+#endif
+
+      r.run();
+
+      if (!spin)
+         break;
+   }
+
+   return 0;
+}
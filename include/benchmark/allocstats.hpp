@@ -0,0 +1,140 @@
+#pragma once
+
+#include <benchmark/benchmark.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if BM_POSIX
+   #include <malloc.h>
+#endif
+
+
+namespace Benchmark
+{
+
+//
+// per-thread heap accounting; only updated in executables that
+// expand BM_COUNT_ALLOCATIONS() once at namespace scope
+//
+struct AllocStats
+{
+   static inline thread_local std::int64_t bytes = 0;   // live, usable size
+   static inline thread_local std::int64_t peak = 0;    // high-water mark of bytes
+   static inline thread_local std::uint64_t allocations = 0;
+
+   // with the accounting off, operator new and delete cost about what
+   // plain malloc() and free() do; a program that compares allocating
+   // code keeps it off and counts in an untimed pass under a Scope
+   static inline std::atomic<bool> enabled = true;
+
+   class Scope final
+   {
+   public:
+      Scope() noexcept
+         : m_was(enabled.exchange(true, std::memory_order_relaxed))
+      {}
+
+      ~Scope()
+      {
+         enabled.store(m_was, std::memory_order_relaxed);
+      }
+
+      Scope(Scope const&) = delete;
+      Scope& operator=(Scope const&) = delete;
+
+   private:
+      bool const m_was;
+   };
+
+   static void* allocate(std::size_t n) noexcept
+   {
+      auto p = std::malloc(n ? n : 1);
+      if (p && enabled.load(std::memory_order_relaxed))
+      {
+         bytes += ::malloc_usable_size(p);
+         if (bytes > peak)
+            peak = bytes;
+
+         ++allocations;
+      }
+
+      return p;
+   }
+
+   static void deallocate(void* p) noexcept
+   {
+      if (p && enabled.load(std::memory_order_relaxed))
+         bytes -= ::malloc_usable_size(p);
+
+      release(p);
+   }
+
+private:
+   // out of line, so GCC does not see free() inlined into operator delete
+   // and take it for a mismatched new / free pair
+   BM_NOINLINE static void release(void* p) noexcept
+   {
+      std::free(p);
+   }
+};
+
+
+} // namespace
+
+
+#define BM_COUNT_ALLOCATIONS() \
+   void* operator new(std::size_t n) \
+   { \
+      auto p = ::Benchmark::AllocStats::allocate(n); \
+      if (!p) \
+         throw std::bad_alloc(); \
+      return p; \
+   } \
+   \
+   void* operator new[](std::size_t n) \
+   { \
+      return operator new(n); \
+   } \
+   \
+   void* operator new(std::size_t n, std::nothrow_t const&) noexcept \
+   { \
+      return ::Benchmark::AllocStats::allocate(n); \
+   } \
+   \
+   void* operator new[](std::size_t n, std::nothrow_t const&) noexcept \
+   { \
+      return ::Benchmark::AllocStats::allocate(n); \
+   } \
+   \
+   void operator delete(void* p) noexcept \
+   { \
+      ::Benchmark::AllocStats::deallocate(p); \
+   } \
+   \
+   void operator delete[](void* p) noexcept \
+   { \
+      ::Benchmark::AllocStats::deallocate(p); \
+   } \
+   \
+   void operator delete(void* p, std::size_t) noexcept \
+   { \
+      ::Benchmark::AllocStats::deallocate(p); \
+   } \
+   \
+   void operator delete[](void* p, std::size_t) noexcept \
+   { \
+      ::Benchmark::AllocStats::deallocate(p); \
+   } \
+   \
+   void operator delete(void* p, std::nothrow_t const&) noexcept \
+   { \
+      ::Benchmark::AllocStats::deallocate(p); \
+   } \
+   \
+   void operator delete[](void* p, std::nothrow_t const&) noexcept \
+   { \
+      ::Benchmark::AllocStats::deallocate(p); \
+   }
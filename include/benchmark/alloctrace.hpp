@@ -0,0 +1,147 @@
+#pragma once
+
+#include <benchmark/benchmark.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if BM_POSIX
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+
+namespace Benchmark
+{
+
+//
+// allocation trace file:
+//    Header, followed by Header::records Record's
+//
+// every live block occupies a slot; slots are recycled, so
+// Header::slots is the peak number of live blocks
+//
+class AllocTrace final
+{
+public:
+   enum class Op : std::uint8_t
+   {
+      Alloc = 1,
+      Free = 2
+   };
+
+   struct Record
+   {
+      Op op;
+      std::uint8_t reserved;
+      std::uint16_t thread;   // recording thread, 0-based
+      std::uint32_t size;     // requested size, also for Free
+      std::uint32_t slot;
+   };
+
+   static_assert(sizeof(Record) == 12);
+
+   struct Header
+   {
+      static constexpr char kMagic[8] = { 'B', 'M', 'A', 'T', 'R', 'C', '0', '1' };
+
+      char magic[8];
+      std::uint32_t threads;
+      std::uint32_t slots;
+      std::uint64_t records;
+   };
+
+   static_assert(sizeof(Header) == 24);
+
+#if BM_POSIX
+
+   AllocTrace() noexcept = default;
+
+   AllocTrace(AllocTrace const&) = delete;
+   AllocTrace& operator=(AllocTrace const&) = delete;
+
+   ~AllocTrace()
+   {
+      close();
+   }
+
+   bool open(char const* path) noexcept
+   {
+      close();
+
+      auto fd = ::open(path, O_RDONLY);
+      if (fd < 0)
+         return false;
+
+      struct stat st = {};
+      if (::fstat(fd, &st) < 0 || std::size_t(st.st_size) < sizeof(Header))
+      {
+         ::close(fd);
+         return false;
+      }
+
+      auto p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (p == MAP_FAILED)
+         return false;
+
+      m_base = p;
+      m_size = st.st_size;
+
+      auto h = &header();
+      auto expected = sizeof(Header) + h->records * sizeof(Record);
+      if (
+         std::memcmp(h->magic, Header::kMagic, sizeof(h->magic)) ||
+         m_size < expected
+         )
+      {
+         close();
+         return false;
+      }
+
+      // replays index their slot table by Record::slot
+      for (auto& r: records())
+      {
+         if (r.slot >= h->slots || (r.op != Op::Alloc && r.op != Op::Free))
+         {
+            close();
+            return false;
+         }
+      }
+
+      ::madvise(m_base, m_size, MADV_SEQUENTIAL);
+      return true;
+   }
+
+   void close() noexcept
+   {
+      if (m_base)
+         ::munmap(m_base, m_size);
+
+      m_base = nullptr;
+      m_size = 0;
+   }
+
+   Header const& header() const noexcept
+   {
+      return *static_cast<Header const*>(m_base);
+   }
+
+   std::span<Record const> records() const noexcept
+   {
+      auto p = static_cast<char const*>(m_base) + sizeof(Header);
+      return { reinterpret_cast<Record const*>(p), header().records };
+   }
+
+private:
+   void* m_base = nullptr;
+   std::size_t m_size = 0;
+
+#endif // BM_POSIX
+};
+
+
+} // namespace
@@ -11,3 +11,6 @@
 
 #define BM_DONT_OPTIMIZE \
   __attribute__((optnone))
+
+#define BM_EXPORT \
+  __attribute__((visibility("default")))
@@ -3,6 +3,9 @@
 
 #include <concepts>
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 
 namespace Benchmark
@@ -13,6 +16,25 @@ using Counter = std::uint64_t;
 using Tid = unsigned;
 
 
+// an extra per-run value a fixture wants to show next to the timings
+struct Metric
+{
+   enum class Kind
+   {
+      Value,   // printed as is
+      Rate     // a total, printed per second of wall time; the first
+               // Rate a fixture reports is taken as the work of all its
+               // threads together, for the runner's scaling figures
+   };
+
+   std::string name;
+   double value;
+   Kind kind = Kind::Value;
+};
+
+using Metrics = std::vector<Metric>;
+
+
 template <typename T>
 concept SimpleBenchmark =
    std::is_invocable_r_v<Counter, T, Counter, Tid>;
@@ -28,8 +50,13 @@ struct Fixture
    virtual void prologue(Tid tid) {}
    virtual Counter run(Counter iterations, Tid tid) = 0;
    virtual void epilogue(Tid tid) {}
+   virtual void report(Metrics& m) {}
    virtual void finalize() {}
 
+   // true if the threads share one fixed amount of work between them
+   // rather than each doing the iterations run() is given
+   virtual bool splitsWork() const { return false; }
+
    template <class T, class... Args>
    static Ptr make(Args... args)
    {
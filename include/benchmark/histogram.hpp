@@ -0,0 +1,133 @@
+#pragma once
+
+#include <benchmark/fixture.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+
+namespace Benchmark
+{
+
+//
+// a log-linear histogram of non-negative integers (typically ns):
+// values below 2^kSubBits are kept exactly, larger ones in 2^kSubBits
+// buckets per power of two, i.e. within ~3%
+//
+class Histogram final
+{
+public:
+   static constexpr unsigned kSubBits = 5;
+
+   void record(std::uint64_t v) noexcept
+   {
+      ++m_buckets[index(v)];
+      ++m_count;
+      m_sum += v;
+      m_min = std::min(m_min, v);
+      m_max = std::max(m_max, v);
+   }
+
+   void merge(Histogram const& other) noexcept
+   {
+      for (std::size_t i = 0; i < kBuckets; ++i)
+         m_buckets[i] += other.m_buckets[i];
+
+      m_count += other.m_count;
+      m_sum += other.m_sum;
+      m_min = std::min(m_min, other.m_min);
+      m_max = std::max(m_max, other.m_max);
+   }
+
+   void clear() noexcept
+   {
+      *this = Histogram{};
+   }
+
+   std::uint64_t count() const noexcept
+   {
+      return m_count;
+   }
+
+   std::uint64_t min() const noexcept
+   {
+      return m_count ? m_min : 0;
+   }
+
+   std::uint64_t max() const noexcept
+   {
+      return m_max;
+   }
+
+   double mean() const noexcept
+   {
+      return m_count ? double(m_sum) / double(m_count) : 0.0;
+   }
+
+   // the value below which p% of the samples are; p in [0, 100]
+   std::uint64_t percentile(double p) const noexcept
+   {
+      if (!m_count)
+         return 0;
+
+      auto rank = std::uint64_t(p / 100.0 * double(m_count) + 0.5);
+      rank = std::clamp<std::uint64_t>(rank, 1, m_count);
+
+      std::uint64_t seen = 0;
+      for (std::size_t i = 0; i < kBuckets; ++i)
+      {
+         seen += m_buckets[i];
+         if (seen >= rank)
+            return std::clamp(middle(i), min(), m_max);
+      }
+
+      return m_max;
+   }
+
+   // p50, p90, p99, p99.9 and max as "<unit> pNN" metrics
+   void report(Metrics& m, std::string const& unit = "ns") const
+   {
+      m.push_back({ unit + " p50", double(percentile(50)) });
+      m.push_back({ unit + " p90", double(percentile(90)) });
+      m.push_back({ unit + " p99", double(percentile(99)) });
+      m.push_back({ unit + " p99.9", double(percentile(99.9)) });
+      m.push_back({ unit + " max", double(max()) });
+   }
+
+private:
+   static constexpr std::size_t kSub = std::size_t{1} << kSubBits;
+   static constexpr std::size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+   static std::size_t index(std::uint64_t v) noexcept
+   {
+      if (v < kSub)
+         return std::size_t(v);
+
+      unsigned msb = 63 - std::countl_zero(v);
+      unsigned shift = msb - kSubBits;
+      return (shift + 1) * kSub + std::size_t((v >> shift) - kSub);
+   }
+
+   static std::uint64_t middle(std::size_t i) noexcept
+   {
+      if (i < kSub)
+         return i;
+
+      unsigned shift = unsigned(i / kSub) - 1;
+      std::uint64_t low = std::uint64_t(kSub + i % kSub) << shift;
+      return low + ((std::uint64_t{1} << shift) >> 1);
+   }
+
+   std::array<std::uint64_t, kBuckets> m_buckets = {};
+   std::uint64_t m_count = 0;
+   std::uint64_t m_sum = 0;
+   std::uint64_t m_min = std::numeric_limits<std::uint64_t>::max();
+   std::uint64_t m_max = 0;
+};
+
+
+} // namespace
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+
+namespace Benchmark
+{
+
+//
+// a fixed amount of work to put between the operations a fixture
+// measures: a chain of dependent integer steps, so its time is the
+// ALU latency times the length on any core width, without touching
+// memory or the FPU; the ns per step is measured once per process
+//
+class Payload final
+{
+public:
+   // about ns nanoseconds of work on this machine
+   explicit Payload(double ns) noexcept
+      : m_steps(ns > 0 ? std::uint64_t(ns / nsPerStep() + 0.5) : 0)
+   {}
+
+   static Payload steps(std::uint64_t n) noexcept
+   {
+      Payload p(0);
+      p.m_steps = n;
+      return p;
+   }
+
+   // the result depends on every step, so none can be dropped
+   std::uint64_t operator()(std::uint64_t seed) const noexcept
+   {
+      return chain(m_steps, seed);
+   }
+
+   std::uint64_t steps() const noexcept
+   {
+      return m_steps;
+   }
+
+   double ns() const noexcept
+   {
+      return double(m_steps) * nsPerStep();
+   }
+
+   // the best of many short timed runs, which some of them get through
+   // without an interrupt, after spinning long enough for the core to
+   // leave any low-power state
+   static double nsPerStep() noexcept
+   {
+      static double const calibrated = []()
+      {
+         constexpr std::uint64_t kSteps = 1 << 16;
+         constexpr auto kWarmup = std::chrono::milliseconds(50);
+
+         std::uint64_t sink = 0;
+         auto warm = std::chrono::steady_clock::now() + kWarmup;
+         while (std::chrono::steady_clock::now() < warm)
+            sink += chain(kSteps, sink);
+
+         auto best = std::chrono::nanoseconds::max();
+         for (int i = 0; i < 200; ++i)
+         {
+            auto started = std::chrono::steady_clock::now();
+            sink += chain(kSteps, sink + 1);
+            best = std::min(best, std::chrono::steady_clock::now() - started);
+         }
+
+         s_sink = sink;
+         return double(best.count()) / double(kSteps);
+      }();
+
+      return calibrated;
+   }
+
+private:
+   static std::uint64_t chain(std::uint64_t n, std::uint64_t x) noexcept
+   {
+      for (std::uint64_t i = 0; i < n; ++i)
+         x = std::rotl(x, 7) + i;
+
+      return x;
+   }
+
+   static inline volatile std::uint64_t s_sink = 0;
+
+   std::uint64_t m_steps;
+};
+
+
+} // namespace
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <benchmark/benchmark.hpp>
+
+#include <cstdint>
+#include <utility>
+
+#if BM_POSIX
+   #include <linux/perf_event.h>
+   #include <sys/ioctl.h>
+   #include <sys/syscall.h>
+   #include <unistd.h>
+#endif
+
+
+namespace Benchmark
+{
+
+
+//
+// a hardware event counted in user mode for the thread that opens it,
+// via perf_event_open; not valid() where the kernel, its
+// perf_event_paranoid setting or a container does not allow it, so
+// callers report the count only when there is one
+//
+class PerfCounter final
+{
+public:
+   enum class Event
+   {
+      Cycles,
+      Instructions,
+      CacheMisses,
+      DtlbLoadMisses,
+      DtlbStoreMisses
+   };
+
+   // counts nothing
+   PerfCounter() noexcept = default;
+
+   explicit PerfCounter(Event e) noexcept
+   {
+#if BM_POSIX
+      perf_event_attr attr = {};
+      attr.size = sizeof(attr);
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+
+      switch (e)
+      {
+      case Event::Cycles:
+         attr.type = PERF_TYPE_HARDWARE;
+         attr.config = PERF_COUNT_HW_CPU_CYCLES;
+         break;
+
+      case Event::Instructions:
+         attr.type = PERF_TYPE_HARDWARE;
+         attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+         break;
+
+      case Event::CacheMisses:
+         attr.type = PERF_TYPE_HARDWARE;
+         attr.config = PERF_COUNT_HW_CACHE_MISSES;
+         break;
+
+      case Event::DtlbLoadMisses:
+         attr.type = PERF_TYPE_HW_CACHE;
+         attr.config = cacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ);
+         break;
+
+      case Event::DtlbStoreMisses:
+         attr.type = PERF_TYPE_HW_CACHE;
+         attr.config = cacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE);
+         break;
+      }
+
+      m_fd = int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+      (void)e;
+#endif
+   }
+
+   PerfCounter(PerfCounter&& o) noexcept
+      : m_fd(std::exchange(o.m_fd, -1))
+   {}
+
+   PerfCounter& operator=(PerfCounter&& o) noexcept
+   {
+      std::swap(m_fd, o.m_fd);
+      return *this;
+   }
+
+   ~PerfCounter()
+   {
+#if BM_POSIX
+      if (m_fd >= 0)
+         ::close(m_fd);
+#endif
+   }
+
+   bool valid() const noexcept
+   {
+      return m_fd >= 0;
+   }
+
+   void start() noexcept
+   {
+#if BM_POSIX
+      if (m_fd >= 0)
+      {
+         ::ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+         ::ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+   }
+
+   // the count since start()
+   std::uint64_t stop() noexcept
+   {
+      std::uint64_t v = 0;
+#if BM_POSIX
+      if (m_fd >= 0)
+      {
+         ::ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+         if (::read(m_fd, &v, sizeof(v)) != sizeof(v))
+            v = 0;
+      }
+#endif
+      return v;
+   }
+
+private:
+#if BM_POSIX
+   static constexpr std::uint64_t cacheEvent(std::uint64_t cache, std::uint64_t op) noexcept
+   {
+      return cache | (op << 8) | (std::uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+   }
+#endif
+
+   int m_fd = -1;
+};
+
+
+
+} // namespace
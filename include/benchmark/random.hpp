@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <concepts>
 #include <cstdint>
+#include <span>
+#include <type_traits>
 
 
 namespace Benchmark
@@ -27,13 +32,249 @@ public:
       return x * 0x2545F4914F6CDD1DULL;
    }
 
-   template <typename T>
+   // uniform in [0, max]; Lemire's multiply-shift, which only divides
+   // in the rare case a draw has to be checked for rejection
+   template <std::integral T>
    T operator()(T max) noexcept
    {
-      return static_cast<T>(
-         (operator()()) % (max + 1)
+      auto range = std::uint64_t(std::make_unsigned_t<T>(max)) + 1;
+      if (range == 0)
+         return static_cast<T>(operator()());
+
+      return static_cast<T>(bounded(operator()(), range));
+   }
+
+   // uniform in [0, 1)
+   double real() noexcept
+   {
+      return double(operator()() >> 11) * 0x1.0p-53;
+   }
+
+   // integers from all bits, floating point values in [0, 1); several
+   // interleaved streams, so the loop is not one long dependency chain
+   template <class T>
+   void fill(std::span<T> out) noexcept
+   {
+      generate(
+         out.size(),
+         [out](std::size_t i, std::uint64_t x) noexcept
+         {
+            out[i] = convert<T>(x);
+         }
+      );
+   }
+
+   // integers uniform in [0, max]
+   template <std::integral T>
+   void fill(std::span<T> out, T max) noexcept
+   {
+      auto range = std::uint64_t(std::make_unsigned_t<T>(max)) + 1;
+      if (range == 0)
+      {
+         fill(out);
+         return;
+      }
+
+      generate(
+         out.size(),
+         [this, out, range](std::size_t i, std::uint64_t x) noexcept
+         {
+            out[i] = static_cast<T>(bounded(x, range));
+         }
       );
    }
+
+private:
+   static constexpr std::size_t kLanes = 8;
+
+   template <class T>
+   static T convert(std::uint64_t x) noexcept
+   {
+      if constexpr (std::is_same_v<T, float>)
+         return float(x >> 40) * 0x1.0p-24f;
+      else if constexpr (std::is_floating_point_v<T>)
+         return T(double(x >> 11) * 0x1.0p-53);
+      else
+         return static_cast<T>(x >> (64 - 8 * sizeof(T)));
+   }
+
+   // the high half of x * range; low halves below 2^64 mod range would
+   // map one value too many to their result, and are drawn again
+   std::uint64_t bounded(std::uint64_t x, std::uint64_t range) noexcept
+   {
+      auto m = static_cast<unsigned __int128>(x) * range;
+      auto low = static_cast<std::uint64_t>(m);
+      if (low < range)
+      {
+         auto threshold = (0 - range) % range;
+         while (low < threshold)
+         {
+            m = static_cast<unsigned __int128>(operator()()) * range;
+            low = static_cast<std::uint64_t>(m);
+         }
+      }
+
+      return static_cast<std::uint64_t>(m >> 64);
+   }
+
+   template <class Sink>
+   void generate(std::size_t n, Sink sink) noexcept
+   {
+      std::uint64_t lanes[kLanes];
+      for (auto& x: lanes)
+         x = operator()();
+
+      std::size_t i = 0;
+      for (; i + kLanes <= n; i += kLanes)
+      {
+         for (std::size_t k = 0; k < kLanes; ++k)
+         {
+            auto x = lanes[k];
+            x ^= x >> 12;
+            x ^= x << 25;
+            x ^= x >> 27;
+            lanes[k] = x;
+            sink(i + k, x * 0x2545F4914F6CDD1DULL);
+         }
+      }
+
+      for (; i < n; ++i)
+         sink(i, operator()());
+
+      m_state ^= lanes[0];
+      if (m_state == 0)
+         m_state = lanes[1];
+   }
+};
+
+
+// exponentially distributed reals with the given rate, by inversion
+class Exponential final
+{
+public:
+   Exponential(double rate = 1.0) noexcept
+      : m_scale(-1.0 / rate)
+   {}
+
+   double operator()(Random& r) const noexcept
+   {
+      return m_scale * std::log1p(-r.real());
+   }
+
+private:
+   double m_scale;
+};
+
+
+// normally distributed reals; Marsaglia's polar method, which yields
+// two values per accepted pair and keeps the second for the next call
+class Normal final
+{
+public:
+   Normal(double mean = 0.0, double stddev = 1.0) noexcept
+      : m_mean(mean)
+      , m_stddev(stddev)
+   {}
+
+   double operator()(Random& r) noexcept
+   {
+      if (m_hasSpare)
+      {
+         m_hasSpare = false;
+         return m_mean + m_stddev * m_spare;
+      }
+
+      double u, v, s;
+      do
+      {
+         u = 2.0 * r.real() - 1.0;
+         v = 2.0 * r.real() - 1.0;
+         s = u * u + v * v;
+      } while (s >= 1.0 || s == 0.0);
+
+      auto f = std::sqrt(-2.0 * std::log(s) / s);
+      m_spare = v * f;
+      m_hasSpare = true;
+      return m_mean + m_stddev * u * f;
+   }
+
+private:
+   double m_mean;
+   double m_stddev;
+   double m_spare = 0.0;
+   bool m_hasSpare = false;
+};
+
+
+// Zipf-distributed integers in [0, n), 0 being the most frequent;
+// rejection-inversion sampling (Hörmann & Derflinger), O(1) per draw
+class Zipf final
+{
+public:
+   Zipf(std::uint64_t n, double exponent = 1.0) noexcept
+      : m_n(n)
+      , m_exponent(exponent)
+      , m_hX1(hIntegral(1.5) - 1.0)
+      , m_hN(hIntegral(double(n) + 0.5))
+      , m_s(2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0)))
+   {}
+
+   std::uint64_t operator()(Random& r) const noexcept
+   {
+      for (;;)
+      {
+         auto u = m_hN + r.real() * (m_hX1 - m_hN);
+         auto x = hIntegralInverse(u);
+         auto k = std::uint64_t(std::max(x + 0.5, 1.0));
+         if (k > m_n)
+            k = m_n;
+
+         if (k - x <= m_s || u >= hIntegral(k + 0.5) - h(double(k)))
+            return k - 1;
+      }
+   }
+
+private:
+   double h(double x) const noexcept
+   {
+      return std::exp(-m_exponent * std::log(x));
+   }
+
+   double hIntegral(double x) const noexcept
+   {
+      auto lx = std::log(x);
+      return helper2((1.0 - m_exponent) * lx) * lx;
+   }
+
+   double hIntegralInverse(double x) const noexcept
+   {
+      auto t = std::max(x * (1.0 - m_exponent), -1.0);
+      return std::exp(helper1(t) * x);
+   }
+
+   // log1p(x) / x
+   static double helper1(double x) noexcept
+   {
+      if (std::abs(x) > 1e-8)
+         return std::log1p(x) / x;
+
+      return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+   }
+
+   // expm1(x) / x
+   static double helper2(double x) noexcept
+   {
+      if (std::abs(x) > 1e-8)
+         return std::expm1(x) / x;
+
+      return 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+   }
+
+   std::uint64_t m_n;
+   double m_exponent;
+   double m_hX1;
+   double m_hN;
+   double m_s;
 };
 
 
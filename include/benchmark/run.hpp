@@ -20,6 +20,7 @@ struct Data
    std::chrono::nanoseconds wallTime;
    std::chrono::nanoseconds cpuTime;
    CpuUsage<std::chrono::microseconds> cpuUsage;
+   Metrics metrics = {};
 };
 
 
@@ -4,7 +4,6 @@
 #include <benchmark/run.hpp>
 #include <benchmark/terminal.hpp>
 
-#include <initializer_list>
 #include <vector>
 
 
@@ -24,12 +23,12 @@ public:
    void add(
       std::string_view name,
       SimpleBenchmark auto&& work,
-      std::initializer_list<unsigned> threads = {1}
+      std::vector<unsigned> threads = {1}
    )
    {
       m_bm.emplace_back(
          name,
-         threads,
+         std::move(threads),
          SimpleFixture::make(std::forward<decltype(work)>(work))
       );
    }
@@ -37,12 +36,12 @@ public:
    void add(
       std::string_view name,
       Fixture::Ptr&& work,
-      std::initializer_list<unsigned> threads = {1}
+      std::vector<unsigned> threads = {1}
    )
    {
       m_bm.emplace_back(
          name,
-         threads,
+         std::move(threads),
          std::move(work)
       );
    }
@@ -69,11 +68,11 @@ private:
 
       Bm(
          std::string_view name,
-         std::initializer_list<unsigned> threads,
+         std::vector<unsigned>&& threads,
          Fixture::Ptr&& work
       )
          : name(name)
-         , threads(threads)
+         , threads(std::move(threads))
          , work(std::move(work))
       {}
    };
@@ -91,6 +90,8 @@ private:
       std::size_t variant
    );
 
+   virtual void printScaling(std::size_t index);
+
    virtual void printHeader();
 
    Terminal m_console;
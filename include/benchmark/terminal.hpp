@@ -22,15 +22,7 @@ namespace Benchmark
 class Terminal
 {
 public:
-   Terminal() noexcept
-      : m_redirected(isRedirected())
-      , m_locale(std::locale(), new numpunct)
-   {
-      detectWindowSize();
-
-      std::cout.imbue(m_locale);
-      std::cerr.imbue(m_locale);
-   }
+   Terminal() noexcept;
 
    bool redirected() const noexcept
    {
@@ -57,6 +49,12 @@ public:
       return m_height;
    }
 
+   // the digit-grouping locale out() and err() are imbued with
+   auto const& locale() const noexcept
+   {
+      return m_locale;
+   }
+
    void line(
       auto& stream,
       char c,
@@ -75,21 +73,6 @@ public:
    }
 
 private:
-   class numpunct
-      : public std::numpunct<char>
-   {
-   protected:
-      std::string do_grouping() const override
-      {
-         return "\003";
-      }
-
-      char do_thousands_sep() const override
-      {
-         return ',';
-      }
-   };
-
    static bool isRedirected() noexcept
    {
 #if BM_POSIX
@@ -53,6 +53,18 @@ template <class IBase, class Derived>
    requires std::is_base_of_v<IBase, Derived>
 struct AnyObject<IBase, Derived>
 {
+   static constexpr std::size_t types = 1;
+
+   static std::unique_ptr<IBase> makeNth(
+      [[maybe_unused]] std::size_t index,
+      auto&&... args
+   )
+   {
+      return std::make_unique<Derived>(
+         std::forward<decltype(args)>(args)...
+      );
+   }
+
    static std::unique_ptr<IBase> make(
       [[maybe_unused]] BoolSource auto const& selector,
       auto&&... args
@@ -86,6 +98,25 @@ struct AnyObject
 {
    using Super = AnyObject<IBase, Others...>;
 
+   static constexpr std::size_t types = 1 + sizeof...(Others);
+
+   // an instance of the index-th type of <Derived, Others...>
+   static std::unique_ptr<IBase> makeNth(
+      std::size_t index,
+      auto&&... args
+   )
+   {
+      if (index == 0)
+         return std::make_unique<Derived>(
+            std::forward<decltype(args)>(args)...
+         );
+      else
+         return Super::makeNth(
+            index - 1,
+            std::forward<decltype(args)>(args)...
+         );
+   }
+
    static std::unique_ptr<IBase> make(
       BoolSource auto const& selector,
       auto&&... args
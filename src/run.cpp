@@ -43,14 +43,17 @@ Data run(
       f->epilogue(0);
    }
 
-   f->finalize();
-
-   return Data {
+   Data d {
       1,
       wallTime.value(),
       cpuTime.value(),
       cpuUsage.value()
    };
+
+   f->report(d.metrics);
+   f->finalize();
+
+   return d;
 }
 
 
@@ -144,8 +147,6 @@ Data run(
    for (auto& w: workers)
       w.join();
 
-   f->finalize();
-
    decltype(Data::cpuTime) cpuTime = {};
    decltype(Data::cpuUsage) cpuUsage = {};
    for (Tid tid = 0; tid < threads; ++tid)
@@ -154,12 +155,17 @@ Data run(
       cpuUsage += cpuUsages[tid].value();
    }
 
-   return Data {
+   Data d {
       threads,
       wallTime.value(),
       cpuTime,
       cpuUsage
    };
+
+   f->report(d.metrics);
+   f->finalize();
+
+   return d;
 }
 
 
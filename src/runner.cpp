@@ -1,13 +1,152 @@
 #include <benchmark/chrono.hpp>
 #include <benchmark/runner.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 
 namespace Benchmark
 {
 
+namespace
+{
+
+void printValue(std::ostream& out, double v, int width)
+{
+   if (v < 1)
+   {
+      out << std::setw(width)
+          << std::setprecision(2) << std::fixed
+          << v;
+   }
+   else
+   {
+      out << std::setw(width)
+          << std::uint64_t(std::round(v));
+   }
+}
+
+void printFixed(std::ostream& out, double v, int precision)
+{
+   out << std::setprecision(precision) << std::fixed << v;
+}
+
+
+// what a variant gets done per second of wall time: the fixture's own
+// Rate metric if it reports one, else the iterations of all its threads
+// together; none for a fixture whose threads split the iterations
+struct Throughput
+{
+   double value = 0;
+   std::string_view unit = "ops/s";
+};
+
+Throughput throughput(Data const& d, Counter iterations, unsigned threads, bool split)
+{
+   auto wall = ns(d.wallTime);
+   if (!wall)
+      return {};
+
+   for (auto& m: d.metrics)
+   {
+      if (m.kind == Metric::Kind::Rate)
+         return { m.value * 1e9 / double(wall), m.name };
+   }
+
+   if (split)
+      return {};
+
+   return { double(iterations) * threads * 1e9 / double(wall) };
+}
+
+
+//
+// the Universal Scalability Law (Gunther): relative capacity
+//    C(N) = N / (1 + σ(N - 1) + κN(N - 1))
+// with σ the contention (serialized share) and κ the coherency cost;
+// N/C(N) - 1 = σ(N - 1) + κN(N - 1) is linear in both, so they are a
+// least-squares fit through the origin, each held at 0 if it would
+// come out negative
+//
+struct Usl
+{
+   double sigma = 0;
+   double kappa = 0;
+
+   static Usl fit(std::vector<std::pair<double, double>> const& capacity) noexcept
+   {
+      double aa = 0, ab = 0, bb = 0, ay = 0, by = 0;
+      for (auto [n, c]: capacity)
+      {
+         auto a = n - 1;
+         auto b = n * (n - 1);
+         auto y = n / c - 1;
+         aa += a * a;
+         ab += a * b;
+         bb += b * b;
+         ay += a * y;
+         by += b * y;
+      }
+
+      Usl u;
+      auto det = aa * bb - ab * ab;
+      if (det > 0)
+      {
+         u.sigma = (ay * bb - by * ab) / det;
+         u.kappa = (by * aa - ay * ab) / det;
+      }
+
+      if (det <= 0 || u.sigma < 0 || u.kappa < 0)
+      {
+         // the better of the two one-parameter fits
+         auto sigmaOnly = Usl{ aa > 0 ? std::max(0.0, ay / aa) : 0, 0 };
+         auto kappaOnly = Usl{ 0, bb > 0 ? std::max(0.0, by / bb) : 0 };
+         u = sigmaOnly.error(capacity) <= kappaOnly.error(capacity) ? sigmaOnly : kappaOnly;
+      }
+
+      return u;
+   }
+
+   double capacity(double n) const noexcept
+   {
+      return n / (1 + sigma * (n - 1) + kappa * n * (n - 1));
+   }
+
+   // the N >= 1 where C(N) peaks, infinity if it keeps growing; at
+   // σ >= 1 a second thread already costs more than it adds
+   double peak() const noexcept
+   {
+      if (sigma >= 1)
+         return 1;
+
+      if (kappa <= 0)
+         return std::numeric_limits<double>::infinity();
+
+      return std::max(1.0, std::sqrt((1 - sigma) / kappa));
+   }
+
+private:
+   double error(std::vector<std::pair<double, double>> const& capacity) const noexcept
+   {
+      double e = 0;
+      for (auto [n, c]: capacity)
+      {
+         auto d = n / c - 1 - sigma * (n - 1) - kappa * n * (n - 1);
+         e += d * d;
+      }
+
+      return e;
+   }
+};
+
+} // namespace
+
+
 void Runner::printCaption()
 {
    m_console.line(out(), '=');
@@ -78,42 +217,118 @@ void Runner::printResult(
 
    auto wall = ns(bm.data[variant].wallTime);
    auto cpu = ns(bm.data[variant].cpuTime);
-   auto op = cpu / double(m_iterations * bm.threads[variant]);
+   auto perThread = bm.work->splitsWork() ? 1 : bm.threads[variant];
+   auto op = cpu / double(m_iterations * perThread);
    auto percent = wall * 100.0 / double(best);
 
    out() << std::setw(2) << bm.threads[variant] << " |"
          << std::setw(12) << (wall / 1000) <<  " |";
 
-   if  (op < 1)
+   printValue(out(), op, 7);
+   out() << " | ";
+   printValue(out(), percent, 5);
+
+   auto u = ms(bm.data[variant].cpuUsage.user);
+   out() << " | " << u;
+
+   auto s = ms(bm.data[variant].cpuUsage.system);
+   if (s > 0)
+      out() << " / " << s;
+
+   for (auto& m: bm.data[variant].metrics)
    {
-      out() << std::setw(7)
-            << std::setprecision(2) << std::fixed
-            << op << " | ";
+      auto v = m.value;
+      if (m.kind == Metric::Kind::Rate)
+         v = wall ? v * 1000000000.0 / double(wall) : 0;
+
+      out() << " | ";
+      printValue(out(), v, 0);
+      out() << " " << m.name;
    }
-   else
+
+   // against the same benchmark on one thread
+   auto n = bm.threads[variant];
+   auto single = std::find(bm.threads.begin(), bm.threads.end(), 1u);
+   if (n > 1 && single != bm.threads.end())
    {
-      out() << std::setw(7)
-            << std::round(op) << " | ";
+      auto& base = bm.data[std::size_t(single - bm.threads.begin())];
+      auto split = bm.work->splitsWork();
+      auto x1 = throughput(base, m_iterations, 1, split).value;
+      if (x1 > 0)
+      {
+         auto speedup = throughput(bm.data[variant], m_iterations, n, split).value / x1;
+
+         out() << " | ";
+         printFixed(out(), speedup, 2);
+         out() << " speedup | ";
+         printValue(out(), 100.0 * speedup / n, 0);
+         out() << " % efficiency";
+      }
    }
 
-   if (percent < 1)
+   out() << std::endl;
+}
+
+void Runner::printScaling(std::size_t index)
+{
+   auto& bm = m_bm[index];
+
+   auto single = std::find(bm.threads.begin(), bm.threads.end(), 1u);
+   if (single == bm.threads.end())
+      return;
+
+   auto split = bm.work->splitsWork();
+   auto base = throughput(bm.data[std::size_t(single - bm.threads.begin())], m_iterations, 1, split);
+   auto x1 = base.value;
+   if (x1 <= 0)
+      return;
+
+   // two parameters need at least two thread counts besides 1
+   std::vector<std::pair<double, double>> capacity;
+   unsigned maxThreads = 1;
+   for (std::size_t variant = 0; variant < bm.threads.size(); ++variant)
+   {
+      auto n = bm.threads[variant];
+      auto c = throughput(bm.data[variant], m_iterations, n, split).value / x1;
+      if (n > 1 && c > 0)
+      {
+         capacity.emplace_back(double(n), c);
+         maxThreads = std::max(maxThreads, n);
+      }
+   }
+
+   if (capacity.size() < 2)
+      return;
+
+   auto usl = Usl::fit(capacity);
+
+   out() << "   USL: σ ";
+   printFixed(out(), usl.sigma, 4);
+   out() << ", κ ";
+   printFixed(out(), usl.kappa, 5);
+
+   auto peak = usl.peak();
+   if (std::isfinite(peak))
+   {
+      out() << "; peak ";
+      printValue(out(), x1 * usl.capacity(peak), 0);
+      out() << " " << base.unit << " at ";
+      printFixed(out(), peak, 1);
+      out() << " threads";
+      if (peak > maxThreads)
+         out() << " (extrapolated)";
+   }
+   else if (usl.sigma > 0)
    {
-      out() << std::setw(5)
-            << std::setprecision(2) << std::fixed
-            << percent;
+      out() << "; no peak, approaches ";
+      printValue(out(), x1 / usl.sigma, 0);
+      out() << " " << base.unit;
    }
    else
    {
-      out() << std::setw(5) << std::round(percent);
+      out() << "; linear";
    }
 
-   auto u = ms(bm.data[variant].cpuUsage.user);
-   out() << " | " << u;
-
-   auto s = ms(bm.data[variant].cpuUsage.system);
-   if (s > 0)
-      out() << " / " << s;
-
    out() << std::endl;
 }
 
@@ -163,6 +378,8 @@ void Runner::run()
       {
          printResult(index, variant);
       }
+
+      printScaling(index);
    }
 
    printFooter();
@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.hpp>
+#include <benchmark/terminal.hpp>
+
+
+namespace Benchmark
+{
+
+namespace
+{
+
+// defined here rather than in the header: libstdc++ facet lookup
+// needs RTTI for user facets, and the examples build with -fno-rtti
+class numpunct
+   : public std::numpunct<char>
+{
+protected:
+   std::string do_grouping() const override
+   {
+      return "\003";
+   }
+
+   char do_thousands_sep() const override
+   {
+      return ',';
+   }
+};
+
+} // namespace
+
+
+Terminal::Terminal() noexcept
+   : m_redirected(isRedirected())
+   , m_locale(std::locale(), new numpunct)
+{
+   detectWindowSize();
+
+   std::cout.imbue(m_locale);
+   std::cerr.imbue(m_locale);
+}
+
+
+} // namespace